@@ -2,11 +2,32 @@
 
 set -xe
 
-CFLAGS="-O3 -std=c99 -Wall -Wextra -pedantic -ggdb -I."
+CFLAGS="-O3 -std=c99 -Wall -Wextra -pedantic -ggdb -I. -I./build"
 LIBS="-lm -lglfw -ldl -lpthread -lGL -lrt -lX11"
 
-mkdir -p ./build/
+mkdir -p ./build/assets/
 
-clang $CFLAGS -o ./build/minesweeper ./src/main.c -L./raylib/raylib-5.0_linux_amd64/lib/ -l:libraylib.a -no-pie -D_DEFAULT_SOURCE $LIBS
+# Embed an asset into the game as a C byte array: embed <file> <name>
+# writes ./build/assets/<name>.h with `static const unsigned char <name>[]`
+embed() {
+    {
+        echo "/* Generated by build.sh from $1, do not edit */"
+        echo "static const unsigned char $2[] = {"
+        od -An -v -tx1 "$1" | sed -e 's/ *$//' -e 's/ \([0-9a-f][0-9a-f]\)/0x\1, /g' -e 's/^/    /' -e 's/ $//'
+        echo "};"
+    } > "./build/assets/$2.h"
+}
 
-x86_64-w64-mingw32-gcc -DPLATFORM_DESKTOP -mwindows -Wall -Wextra -ggdb -I./raylib/raylib-5.0_win64_mingw-w64/include/ $CFLAGS -o ./build/minesweeper.exe ./src/main.c -L./raylib/raylib-5.0_win64_mingw-w64/lib -l:libraylib.a -lwinmm -lgdi32 -static
+embed ./assets/fonts/OpenSans-Regular.ttf open_sans_regular_ttf
+embed ./assets/sounds/open_cell.wav open_cell_wav
+embed ./assets/images/flag.png flag_png
+embed ./assets/images/clock.png clock_png
+embed ./assets/images/bomb.png bomb_png
+
+clang $CFLAGS -o ./build/minesweeper ./src/main.c ./src/board.c ./src/endless.c ./src/replay.c ./src/solver.c ./src/no_guess.c -L./raylib/raylib-5.0_linux_amd64/lib/ -l:libraylib.a -no-pie -D_DEFAULT_SOURCE $LIBS
+
+clang $CFLAGS -o ./build/bench ./src/bench.c ./src/board.c ./src/solver.c ./src/probability.c ./src/no_guess.c ./src/replay.c -D_DEFAULT_SOURCE -lm -lpthread
+
+clang $CFLAGS -o ./build/tournament ./src/tournament.c ./src/board.c ./src/solver.c ./src/probability.c -D_DEFAULT_SOURCE -lm -lpthread
+
+x86_64-w64-mingw32-gcc -DPLATFORM_DESKTOP -mwindows -Wall -Wextra -ggdb -I./raylib/raylib-5.0_win64_mingw-w64/include/ $CFLAGS -o ./build/minesweeper.exe ./src/main.c ./src/board.c ./src/endless.c ./src/replay.c ./src/solver.c ./src/no_guess.c -L./raylib/raylib-5.0_win64_mingw-w64/lib -l:libraylib.a -lwinmm -lgdi32 -lpthread -static
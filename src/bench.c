@@ -0,0 +1,984 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "board.h"
+#include "solver.h"
+#include "probability.h"
+#include "no_guess.h"
+#include "replay.h"
+
+/* Headless benchmarks for the board engine. Build with ./build.sh and
+ * run ./build/bench for the comparisons against the old implementations,
+ * or ./build/bench --json [--baseline <file>] [--tolerance <share>]
+ * [--tolerance-ns <ns>] for
+ * the regression suite */
+
+#define FLOOD_FILL_REPEATS 200
+#define BOMBS_AROUND_REPEATS 5
+#define PLACEMENT_REPEATS 5
+#define FIRST_CLICK_REPEATS 5
+#define SOLVER_GAMES 1000
+#define PROBABILITY_GAMES 200
+#define PROBABILITY_THREADS 4
+/* Games on the board too big to rescan for every move */
+#define PROBABILITY_BIG_GAMES 5
+#define NO_GUESS_BOARDS 1000
+/* Boards also generated on one thread, to check they come out the same */
+#define NO_GUESS_CHECKED_BOARDS 50
+#define FRAME_BUDGET_MS (1000.0/30)
+#define CHORD_GAMES 1000
+#define CHORD_REPLAY_REPEATS 5
+
+static Board board;
+static Board pristine;
+static Solver solver;
+
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+
+/* The full-board rescan that board_reveal() used before the worklist fill,
+ * kept here as the reference to compare against */
+static void legacy_open_empty_cells(Board *board)
+{
+    bool run = true;
+    while (run) {
+        run = false;
+        for (int y = 0; y < board->rows; y++) {
+            for (int x = 0; x < board->columns; x++) {
+                cell c = board->cells[y * board->columns + x];
+                if (cell_get_state(c) != OPEN) continue;
+                if (cell_bombs_around(c) != 0) continue;
+
+                for (int sy = -1; sy <= 1; sy++) {
+                    for (int sx = -1; sx <= 1; sx++) {
+                        if (sx == 0 && sy == 0) continue;
+                        if (x + sx < 0 || x + sx >= board->columns) continue;
+                        if (y + sy < 0 || y + sy >= board->rows) continue;
+                        cell *neighbour = &board->cells[(y + sy) * board->columns + (x + sx)];
+                        if (cell_get_state(*neighbour) != OPEN) {
+                            *neighbour = cell_with_state(*neighbour, OPEN);
+                            run = true;
+                            board->score++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/* The rejection sampling board_init() used before Floyd's sampling */
+static void legacy_place_bombs(Board *board, int bombs)
+{
+    int cells = board->columns*board->rows;
+    for (int i = 0; i < bombs; i++) {
+        int cell_index = rand() % cells;
+        while (cell_is_bomb(board->cells[cell_index])) cell_index = rand() % cells;
+        board->cells[cell_index] |= CELL_BOMB_BIT;
+    }
+}
+
+
+/* The branchy 3x3 scan that board_calc_bombs_around() used before the
+ * SIMD kernels */
+static void legacy_calc_bombs_around(Board *board)
+{
+    int columns = board->columns;
+    int rows = board->rows;
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < columns; x++) {
+            int bombs_around = 0;
+            for (int sy = -1; sy <= 1; sy++) {
+                for (int sx = -1; sx <= 1; sx++) {
+                     if (sx == 0 && sy == 0) continue;
+                     if (x + sx < 0 || x + sx >= columns) continue;
+                     if (y + sy < 0 || y + sy >= rows) continue;
+
+                     if (cell_is_bomb(board->cells[(sy+y)*columns + (sx+x)])) bombs_around += 1;
+                }
+            }
+            cell *c = &board->cells[y*columns + x];
+            *c = (*c & ~CELL_BOMBS_AROUND_MASK) | bombs_around;
+        }
+    }
+}
+
+
+/* Corridors three cells high separated by walls of bombs, with the gap in
+ * every wall on alternating sides. Opening the bottom corridor floods the
+ * whole board along a path the row-major rescan can only advance by one
+ * row or column per pass */
+static void make_serpentine_board(Board *board, int columns, int rows)
+{
+    board_init(board, columns, rows, 0, 0);
+    board->bombs = 0;
+    for (int y = 3; y < rows; y += 4) {
+        bool gap_on_left = (y/4) % 2 == 1;
+        for (int x = 0; x < columns; x++) {
+            if (gap_on_left && x < 3) continue;
+            if (!gap_on_left && x >= columns - 3) continue;
+            board->cells[y*columns + x] |= CELL_BOMB_BIT;
+            board->bombs++;
+        }
+    }
+    board->closed_safe_cells = columns*rows - board->bombs;
+    board_calc_bombs_around(board);
+    board->is_field_generated = true;
+}
+
+
+static void bench_flood_fill(const char *name, int click_x, int click_y)
+{
+    double legacy_time = 0;
+    double worklist_time = 0;
+    int opened = 0;
+
+    for (int i = 0; i < FLOOD_FILL_REPEATS; i++) {
+        board_copy(&board, &pristine);
+        double start = now_seconds();
+        cell *clicked = &board.cells[click_y*board.columns + click_x];
+        *clicked = cell_with_state(*clicked, OPEN);
+        legacy_open_empty_cells(&board);
+        legacy_time += now_seconds() - start;
+        opened = board.score;
+
+        board_copy(&board, &pristine);
+        start = now_seconds();
+        board_reveal(&board, click_x, click_y);
+        worklist_time += now_seconds() - start;
+    }
+
+    legacy_time /= FLOOD_FILL_REPEATS;
+    worklist_time /= FLOOD_FILL_REPEATS;
+    printf("%-24s %8d %12.3f %12.3f %8.1fx\n",
+           name, opened, legacy_time*1e3, worklist_time*1e3, legacy_time/worklist_time);
+}
+
+
+static void bench_bombs_around(int columns, int rows)
+{
+    static const struct {
+        simd_level level;
+        const char *name;
+    } kernels[] = {
+        {SIMD_NONE, "scalar"},
+        {SIMD_SSE2, "sse2"},
+        {SIMD_AVX2, "avx2"},
+    };
+
+    board_init(&pristine, columns, rows, 15.625, 1);
+    board_generate(&pristine, 0, 0);
+    board_copy(&board, &pristine);
+    double start = now_seconds();
+    for (int i = 0; i < BOMBS_AROUND_REPEATS; i++) legacy_calc_bombs_around(&board);
+    double legacy_time = (now_seconds() - start)/BOMBS_AROUND_REPEATS;
+
+    printf("%5dx%-6d %10.3f", columns, rows, legacy_time*1e3);
+    for (size_t k = 0; k < sizeof(kernels)/sizeof(kernels[0]); k++) {
+        if (!board_simd_supported(kernels[k].level)) {
+            printf(" %10s", "-");
+            continue;
+        }
+        /* Wipe the counts so a kernel that writes nothing can't pass */
+        for (int i = 0; i < columns*rows; i++) board.cells[i] &= ~CELL_BOMBS_AROUND_MASK;
+        start = now_seconds();
+        for (int i = 0; i < BOMBS_AROUND_REPEATS; i++) board_calc_bombs_around_simd(&board, kernels[k].level);
+        double kernel_time = (now_seconds() - start)/BOMBS_AROUND_REPEATS;
+        if (memcmp(board.cells, pristine.cells, columns*rows) != 0) {
+            fprintf(stderr, "ERROR: %s kernel disagrees with the reference\n", kernels[k].name);
+            exit(1);
+        }
+        printf(" %10.3f", kernel_time*1e3);
+    }
+    printf("\n");
+}
+
+
+static void clear_bombs(Board *board)
+{
+    memset(board->cells, cell_with_state(0, CLOSE), board->columns*board->rows);
+}
+
+
+/* Old rejection sampling against both placement methods, each timed on
+ * its own. "used" is the method board_place_bombs() picks for the board */
+static void bench_bomb_placement(int columns, int rows, float bomb_percent)
+{
+    static const placement_method methods[] = {PLACEMENT_FLOYD, PLACEMENT_SEQUENTIAL};
+
+    board_init(&board, columns, rows, 0, 1);
+    int bombs = (double)columns*rows*bomb_percent/100;
+
+    double legacy_time = 0;
+    double method_times[2] = {0};
+    for (int i = 0; i < PLACEMENT_REPEATS; i++) {
+        clear_bombs(&board);
+        double start = now_seconds();
+        legacy_place_bombs(&board, bombs);
+        legacy_time += now_seconds() - start;
+
+        for (int m = 0; m < 2; m++) {
+            clear_bombs(&board);
+            start = now_seconds();
+            board_place_bombs_method(&board, bombs, NULL, 0, methods[m]);
+            method_times[m] += now_seconds() - start;
+
+            int placed = 0;
+            for (int k = 0; k < columns*rows; k++) placed += cell_is_bomb(board.cells[k]);
+            if (placed != bombs) {
+                fprintf(stderr, "ERROR: placed %d bombs instead of %d\n", placed, bombs);
+                exit(1);
+            }
+        }
+    }
+
+    legacy_time /= PLACEMENT_REPEATS;
+    for (int m = 0; m < 2; m++) method_times[m] /= PLACEMENT_REPEATS;
+    bool is_sequential = board_placement_method(&board, bombs) == PLACEMENT_SEQUENTIAL;
+    printf("%5dx%-6d %6.2f%% %10.3f %10.3f %14.3f %11s %8.1fx\n",
+           columns, rows, bomb_percent, legacy_time*1e3, method_times[0]*1e3, method_times[1]*1e3,
+           is_sequential ? "sequential" : "floyd", legacy_time/method_times[is_sequential]);
+}
+
+
+/* The first reveal places the bombs, counts them and floods the opening
+ * around the clicked cell. Below SLOW_GENERATION_MIN_CELLS the game does
+ * all of it within the frame of the click, above it the generation runs
+ * on a worker and the frame it ends in only floods the opening */
+static void bench_first_click(int columns, int rows)
+{
+    double generate_time = 0;
+    double open_time = 0;
+    for (int i = 0; i < FIRST_CLICK_REPEATS; i++) {
+        board_init(&board, columns, rows, 15.625, i);
+        double start = now_seconds();
+        board_generate(&board, columns/2, rows/2);
+        generate_time += now_seconds() - start;
+
+        start = now_seconds();
+        board_reveal(&board, columns/2, rows/2);
+        open_time += now_seconds() - start;
+    }
+
+    generate_time /= FIRST_CLICK_REPEATS;
+    open_time /= FIRST_CLICK_REPEATS;
+    bool is_on_worker = columns*rows >= SLOW_GENERATION_MIN_CELLS;
+    double frame_time = is_on_worker ? open_time : generate_time + open_time;
+    printf("%5dx%-6d %12.3f %12.3f %8s %12.3f %8s\n", columns, rows, generate_time*1e3, open_time*1e3,
+           is_on_worker ? "yes" : "no", frame_time*1e3, frame_time*1e3 <= FRAME_BUDGET_MS ? "yes" : "NO");
+}
+
+
+/* Play one game of the corpus by revealing only the cells the solver
+ * proves safe, updating it after every reveal. With `from_scratch` the
+ * solver forgets everything and rescans the board instead. Returns true
+ * if the game was won without a guess */
+static bool play_solver_game(int columns, int rows, float bomb_percent, uint64_t seed, bool from_scratch)
+{
+    board_init(&board, columns, rows, bomb_percent, seed);
+    solver_reset(&solver, &board);
+    board_reveal(&board, columns/2, rows/2);
+    solver_update(&solver, &board);
+    board_clear_changes(&board);
+
+    int x, y;
+    while (solver_next_safe(&solver, &board, &x, &y)) {
+        board_reveal(&board, x, y);
+        if (from_scratch) {
+            solver_reset(&solver, &board);
+            board.is_all_changed = true;
+        }
+        solver_update(&solver, &board);
+        board_clear_changes(&board);
+    }
+
+    for (int i = 0; i < columns*rows; i++) {
+        int cx = i % columns;
+        int cy = i / columns;
+        bool is_bomb = cell_is_bomb(board.cells[i]);
+        if ((solver_is_safe(&solver, cx, cy) && is_bomb) || (solver_is_bomb(&solver, cx, cy) && !is_bomb)) {
+            fprintf(stderr, "ERROR: solver got (%d, %d) wrong on seed %llu\n", cx, cy, (unsigned long long)seed);
+            exit(1);
+        }
+    }
+    return board_get_status(&board) == BOARD_WON;
+}
+
+
+static void bench_solver(int columns, int rows, float bomb_percent)
+{
+    long deduced = 0;
+    int won = 0;
+    double start = now_seconds();
+    for (int i = 0; i < SOLVER_GAMES; i++) {
+        won += play_solver_game(columns, rows, bomb_percent, i + 1, false);
+        deduced += solver.deduced_safe + solver.deduced_bombs;
+    }
+    double incremental_time = now_seconds() - start;
+
+    int scratch_won = 0;
+    start = now_seconds();
+    for (int i = 0; i < SOLVER_GAMES; i++) {
+        scratch_won += play_solver_game(columns, rows, bomb_percent, i + 1, true);
+    }
+    double scratch_time = now_seconds() - start;
+    if (scratch_won != won) {
+        fprintf(stderr, "ERROR: rescanning solver won %d games instead of %d\n", scratch_won, won);
+        exit(1);
+    }
+
+    printf("%5dx%-6d %6.2f%% %7.1f%% %10.0f %12.2f %12.3f %12.3f\n",
+           columns, rows, bomb_percent, 100.0*won/SOLVER_GAMES, (double)deduced/SOLVER_GAMES,
+           deduced/incremental_time*1e-6, incremental_time*1e3/SOLVER_GAMES, scratch_time*1e3/SOLVER_GAMES);
+}
+
+
+typedef struct {
+    int won;
+    int computes;
+    long components;
+    long cache_hits;
+    long estimated;
+    double compute_time;
+    /* Sum of every computed probability, equal for equal results */
+    double checksum;
+} Probability_Stats;
+
+/* Play a corpus game revealing the solver's safe cells, and the cell
+ * least likely to be a bomb when there are none. With `from_scratch` the
+ * engine takes in the whole board for every move instead of the cells
+ * that changed */
+static void play_probability_game(Probability *engine, int columns, int rows, float bomb_percent,
+                                  uint64_t seed, bool from_scratch, Probability_Stats *stats)
+{
+    board_init(&board, columns, rows, bomb_percent, seed);
+    solver_reset(&solver, &board);
+    board_reveal(&board, columns/2, rows/2);
+
+    while (board_get_status(&board) == BOARD_PLAYING) {
+        solver_update(&solver, &board);
+        board_clear_changes(&board);
+        int x, y;
+        if (!solver_next_safe(&solver, &board, &x, &y)) {
+            if (from_scratch) solver.is_all_changed = true;
+            double start = now_seconds();
+            if (!probability_compute(engine, &board, &solver)) {
+                fprintf(stderr, "ERROR: no probabilities on seed %llu\n", (unsigned long long)seed);
+                exit(1);
+            }
+            stats->compute_time += now_seconds() - start;
+            stats->computes++;
+            stats->components += engine->component_count;
+            stats->cache_hits += engine->cache_hits;
+            stats->estimated += engine->estimated_count;
+            solver_clear_changes(&solver);
+
+            /* The expected count of bombs is the count of bombs */
+            double expected_bombs = 0;
+            for (int i = 0; i < columns*rows; i++) {
+                double probability = probability_of(engine, i % columns, i / columns);
+                if (cell_get_state(board.cells[i]) != OPEN) expected_bombs += probability;
+                stats->checksum += probability*(i + 1);
+            }
+            stats->checksum += expected_bombs;
+            if (fabs(expected_bombs - board.bombs) > 1e-6) {
+                fprintf(stderr, "ERROR: probabilities add up to %f bombs instead of %d on seed %llu\n",
+                        expected_bombs, board.bombs, (unsigned long long)seed);
+                exit(1);
+            }
+            probability_safest_cell(engine, &board, &solver, &x, &y);
+        }
+        board_reveal(&board, x, y);
+    }
+    stats->won += board_get_status(&board) == BOARD_WON;
+}
+
+
+/* The same games with the engine on the calling thread, on a pool of
+ * workers and taking in the whole board for every move */
+static void bench_probability(int columns, int rows, float bomb_percent, int games)
+{
+    Probability_Stats stats[3] = {0};
+    static const int threads[3] = {0, PROBABILITY_THREADS, 0};
+    for (int t = 0; t < 3; t++) {
+        Probability engine;
+        probability_init(&engine, threads[t]);
+        for (int i = 0; i < games; i++) {
+            play_probability_game(&engine, columns, rows, bomb_percent, i + 1, t == 2, &stats[t]);
+        }
+        probability_free(&engine);
+    }
+    if (stats[0].won != stats[1].won || stats[0].checksum != stats[1].checksum) {
+        fprintf(stderr, "ERROR: probabilities depend on the thread count\n");
+        exit(1);
+    }
+    /* Components are combined in another order, which moves the last bits */
+    if (stats[0].won != stats[2].won || fabs(stats[0].checksum - stats[2].checksum) > 1e-9*fabs(stats[0].checksum)) {
+        fprintf(stderr, "ERROR: probabilities from scratch differ from the incremental ones\n");
+        exit(1);
+    }
+
+    Probability_Stats *s = &stats[0];
+    printf("%5dx%-6d %6.2f%% %7.1f%% %10.1f %10.1f %9.1f%% %9.1f%% %12.3f %12.3f %12.3f\n",
+           columns, rows, bomb_percent, 100.0*s->won/games,
+           (double)s->computes/games, (double)s->components/s->computes,
+           100.0*s->cache_hits/s->components, 100.0*s->estimated/s->components,
+           s->compute_time*1e3/s->computes, stats[1].compute_time*1e3/stats[1].computes,
+           stats[2].compute_time*1e3/stats[2].computes);
+}
+
+
+static int compare_doubles(const void *a, const void *b);
+
+/* Time to generate a no guess board behind the first click, over a corpus
+ * of seeds */
+static void bench_no_guess(int columns, int rows, int bombs, int threads)
+{
+    static double times[NO_GUESS_BOARDS];
+    float bomb_percent = 100.0*(bombs + 0.5)/(columns*rows);
+    long attempts = 0;
+    int found = 0;
+    for (int i = 0; i < NO_GUESS_BOARDS; i++) {
+        board_init(&board, columns, rows, bomb_percent, i + 1);
+        int tried;
+        double start = now_seconds();
+        found += no_guess_generate(&board, columns/2, rows/2, threads, &tried);
+        times[i] = now_seconds() - start;
+        attempts += tried;
+
+        if (i >= NO_GUESS_CHECKED_BOARDS) continue;
+        board_init(&pristine, columns, rows, bomb_percent, i + 1);
+        no_guess_generate(&pristine, columns/2, rows/2, 1, NULL);
+        if (board_hash(&board) != board_hash(&pristine)) {
+            fprintf(stderr, "ERROR: no guess board of seed %d depends on the thread count\n", i + 1);
+            exit(1);
+        }
+    }
+
+    qsort(times, NO_GUESS_BOARDS, sizeof(times[0]), compare_doubles);
+    printf("%5dx%-6d %6d %8d %7.1f%% %10.1f %10.3f %10.3f %10.3f\n",
+           columns, rows, bombs, threads, 100.0*found/NO_GUESS_BOARDS, (double)attempts/NO_GUESS_BOARDS,
+           times[NO_GUESS_BOARDS/2]*1e3, times[NO_GUESS_BOARDS*99/100]*1e3, times[NO_GUESS_BOARDS - 1]*1e3);
+}
+
+
+/* Naive chord for comparison, not an old version of board_chord(): count
+ * the flags, then board_reveal() each neighbour, so every one runs its
+ * own flood fill and end of game check */
+static void per_cell_chord(Board *board, int x, int y)
+{
+    cell c = board->cells[y*board->columns + x];
+    if (cell_get_state(c) != OPEN || cell_bombs_around(c) == 0) return;
+    int flags = 0;
+    for (int sy = -1; sy <= 1; sy++) {
+        for (int sx = -1; sx <= 1; sx++) {
+            if (x + sx < 0 || x + sx >= board->columns || y + sy < 0 || y + sy >= board->rows) continue;
+            flags += cell_get_state(board->cells[(y + sy)*board->columns + x + sx]) == FLAG;
+        }
+    }
+    if (flags != cell_bombs_around(c)) return;
+    for (int sy = -1; sy <= 1; sy++) {
+        for (int sx = -1; sx <= 1; sx++) board_reveal(board, x + sx, y + sy);
+    }
+}
+
+
+/* Record a corpus game played the way an expert plays: flag every bomb
+ * the solver proves, chord every satisfied number, reveal the remaining
+ * safe cells one by one and guess the first undecided cell when stuck */
+static void record_chord_game(int columns, int rows, float bomb_percent, uint64_t seed, Recording *recording)
+{
+    board_init(&board, columns, rows, bomb_percent, seed);
+    solver_reset(&solver, &board);
+    recording_start(recording, seed, columns, rows, bomb_percent);
+    recording_add_event(recording, EVENT_REVEAL, 0, columns/2, rows/2);
+    board_reveal(&board, columns/2, rows/2);
+
+    while (board_get_status(&board) == BOARD_PLAYING) {
+        solver_update(&solver, &board);
+        board_clear_changes(&board);
+
+        for (int i = 0; i < columns*rows; i++) {
+            if ((solver.cells[i] & SOLVER_BOMB_BIT) == 0 || cell_get_state(board.cells[i]) != CLOSE) continue;
+            recording_add_event(recording, EVENT_TOGGLE_FLAG, 0, i % columns, i / columns);
+            board_toggle_flag(&board, i % columns, i / columns);
+        }
+
+        int chorded = 0;
+        for (int i = 0; i < columns*rows && board_get_status(&board) == BOARD_PLAYING; i++) {
+            if (cell_get_state(board.cells[i]) != OPEN || cell_bombs_around(board.cells[i]) == 0) continue;
+            int x = i % columns;
+            int y = i / columns;
+            int closed = 0;
+            for (int sy = -1; sy <= 1; sy++) {
+                for (int sx = -1; sx <= 1; sx++) {
+                    if (x + sx < 0 || x + sx >= columns || y + sy < 0 || y + sy >= rows) continue;
+                    closed += cell_get_state(board.cells[(y + sy)*columns + x + sx]) == CLOSE;
+                }
+            }
+            if (closed == 0 || board_chord(&board, x, y) == 0) continue;
+            recording_add_event(recording, EVENT_CHORD, 0, x, y);
+            chorded++;
+        }
+        if (chorded > 0) continue;
+
+        int x, y;
+        if (!solver_next_safe(&solver, &board, &x, &y)) {
+            int i = 0;
+            while (cell_get_state(board.cells[i]) != CLOSE || (solver.cells[i] & SOLVER_BOMB_BIT) != 0) i++;
+            x = i % columns;
+            y = i / columns;
+        }
+        recording_add_event(recording, EVENT_REVEAL, 0, x, y);
+        board_reveal(&board, x, y);
+    }
+    recording_finish(recording, &board);
+}
+
+
+/* Replay with the chords of the engine or with per_cell_chord(). Returns
+ * true if the board ends in the recorded state */
+static bool replay_chord_game(const Recording *recording, bool is_per_cell)
+{
+    board_init(&board, recording->columns, recording->rows, recording->bomb_percent, recording->seed);
+    for (int i = 0; i < recording->event_count; i++) {
+        const Replay_Event *event = &recording->events[i];
+        switch (event->type) {
+        case EVENT_REVEAL: board_reveal(&board, event->x, event->y); break;
+        case EVENT_TOGGLE_FLAG: board_toggle_flag(&board, event->x, event->y); break;
+        case EVENT_CHORD:
+            if (is_per_cell) per_cell_chord(&board, event->x, event->y);
+            else board_chord(&board, event->x, event->y);
+            break;
+        }
+    }
+    return board_hash(&board) == recording->final_hash;
+}
+
+
+/* Replays of chord heavy games, with every chord batched by the engine
+ * against a naive loop of board_reveal() over the neighbours */
+static void bench_chord_replay(int columns, int rows, float bomb_percent)
+{
+    static Recording recordings[CHORD_GAMES];
+    long events = 0;
+    long chords = 0;
+    long opened = 0;
+    for (int i = 0; i < CHORD_GAMES; i++) {
+        record_chord_game(columns, rows, bomb_percent, i + 1, &recordings[i]);
+        events += recordings[i].event_count;
+        for (int k = 0; k < recordings[i].event_count; k++) chords += recordings[i].events[k].type == EVENT_CHORD;
+        opened += recordings[i].final_score;
+    }
+
+    double times[2];
+    for (int per_cell = 0; per_cell < 2; per_cell++) {
+        double start = now_seconds();
+        for (int repeat = 0; repeat < CHORD_REPLAY_REPEATS; repeat++) {
+            for (int i = 0; i < CHORD_GAMES; i++) {
+                if (replay_chord_game(&recordings[i], per_cell)) continue;
+                fprintf(stderr, "ERROR: replay of seed %d did not end in the recorded state\n", i + 1);
+                exit(1);
+            }
+        }
+        times[per_cell] = (now_seconds() - start)/CHORD_REPLAY_REPEATS;
+    }
+    for (int i = 0; i < CHORD_GAMES; i++) recording_free(&recordings[i]);
+
+    printf("%5dx%-6d %6.2f%% %10.1f %10.1f %10.1f %12.3f %12.3f %9.2f\n",
+           columns, rows, bomb_percent, (double)events/CHORD_GAMES, (double)chords/CHORD_GAMES,
+           (double)opened/CHORD_GAMES, times[1]*1e6/CHORD_GAMES, times[0]*1e6/CHORD_GAMES, times[1]/times[0]);
+}
+
+
+/* Machine readable suite: every engine hot path over several sizes and
+ * densities, each repeated until its mean is stable */
+
+#define MIN_SAMPLES       50
+#define MAX_SAMPLES       10000
+#define MAX_MEASURE_TIME  0.5
+/* Stop once the standard error of the mean is within this share of it */
+#define STABLE_ERROR      0.005
+/* Operations that need no setup are repeated within a sample until it
+ * takes about this long, so the timer overhead does not dominate */
+#define MIN_SAMPLE_TIME   10e-6
+#define MAX_BATCH         10000
+#define DEFAULT_TOLERANCE 0.20
+/* A slowdown must also be this many nanoseconds per operation: below a
+ * microsecond the timer and the scheduler move medians by far more than
+ * 20%, so sub-microsecond operations can't fail the suite by chance */
+#define DEFAULT_TOLERANCE_NS 1000
+#define MAX_RESULTS       128
+
+typedef enum {
+    OP_INIT = 0,
+    OP_GENERATE,
+    OP_FLOOD_FILL,
+    OP_REVEAL_ALL,
+    OP_FLAG_ALL,
+    OP_CHORD_ALL,
+} bench_op;
+
+static const char *op_names[] = {
+    [OP_INIT]       = "init",
+    [OP_GENERATE]   = "generate",
+    [OP_FLOOD_FILL] = "flood_fill",
+    [OP_REVEAL_ALL] = "reveal_all",
+    [OP_FLAG_ALL]   = "flag_all",
+    [OP_CHORD_ALL]  = "chord_all",
+};
+
+typedef struct {
+    char name[32];
+    int columns;
+    int rows;
+    float bomb_percent;
+    int samples;
+    double median_ns;
+    double mean_ns;
+    double min_ns;
+    /* Standard error of the mean relative to the mean */
+    double error;
+} Bench_Result;
+
+static double samples[MAX_SAMPLES];
+/* Cells the sequence of an operation plays on, found once per measure() */
+static int *moves;
+static int move_count;
+static int move_capacity;
+static Bench_Result results[MAX_RESULTS];
+static int result_count = 0;
+static volatile int sink;
+
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+/* Time one sample of `op` in nanoseconds per operation. The untimed setup
+ * brings the board into the state the operation starts from */
+static double run_sample(bench_op op, int batch, int columns, int rows, float bomb_percent, uint64_t seed)
+{
+    double start = 0;
+    double time = 0;
+    switch (op) {
+    case OP_INIT:
+        start = now_seconds();
+        for (int i = 0; i < batch; i++) board_init(&board, columns, rows, bomb_percent, seed);
+        time = now_seconds() - start;
+        break;
+    case OP_GENERATE:
+        board_init(&board, columns, rows, bomb_percent, seed);
+        start = now_seconds();
+        board_generate(&board, columns/2, rows/2);
+        time = now_seconds() - start;
+        break;
+    case OP_FLOOD_FILL:
+        /* The opening around the first click */
+        board_copy(&board, &pristine);
+        start = now_seconds();
+        sink = board_reveal(&board, columns/2, rows/2);
+        time = now_seconds() - start;
+        break;
+    case OP_REVEAL_ALL:
+        /* Every safe cell in row order, each reveal checking for the win */
+        board_copy(&board, &pristine);
+        start = now_seconds();
+        for (int i = 0; i < move_count; i++) sink = board_reveal(&board, moves[i] % columns, moves[i] / columns);
+        time = now_seconds() - start;
+        break;
+    case OP_FLAG_ALL:
+        /* Every bomb flagged and unflagged */
+        board_copy(&board, &pristine);
+        start = now_seconds();
+        for (int i = 0; i < move_count; i++) board_toggle_flag(&board, moves[i] % columns, moves[i] / columns);
+        for (int i = 0; i < move_count; i++) board_toggle_flag(&board, moves[i] % columns, moves[i] / columns);
+        time = now_seconds() - start;
+        break;
+    case OP_CHORD_ALL:
+        /* Every number in row order with all the bombs flagged, starting
+         * from the opening of the first click */
+        board_copy(&board, &pristine);
+        for (int i = 0; i < columns*rows; i++) {
+            if (cell_is_bomb(board.cells[i])) board_toggle_flag(&board, i % columns, i / columns);
+        }
+        board_reveal(&board, columns/2, rows/2);
+        start = now_seconds();
+        for (int i = 0; i < move_count; i++) sink = board_chord(&board, moves[i] % columns, moves[i] / columns);
+        time = now_seconds() - start;
+        break;
+    }
+    return time*1e9/batch;
+}
+
+
+static void measure(bench_op op, int columns, int rows, float bomb_percent)
+{
+    if (op != OP_INIT && op != OP_GENERATE) {
+        board_init(&pristine, columns, rows, bomb_percent, 1);
+        board_generate(&pristine, columns/2, rows/2);
+    }
+    if (columns*rows > move_capacity) {
+        moves = realloc(moves, columns*rows*sizeof(*moves));
+        if (moves == NULL) {
+            fprintf(stderr, "ERROR: could not allocate the moves of %dx%d\n", columns, rows);
+            exit(1);
+        }
+        move_capacity = columns*rows;
+    }
+    move_count = 0;
+    for (int i = 0; i < columns*rows && op >= OP_REVEAL_ALL; i++) {
+        cell c = pristine.cells[i];
+        bool is_move = op == OP_FLAG_ALL ? cell_is_bomb(c)
+                     : op == OP_CHORD_ALL ? !cell_is_bomb(c) && cell_bombs_around(c) > 0
+                     : !cell_is_bomb(c);
+        if (is_move) moves[move_count++] = i;
+    }
+
+    int batch = 1;
+    if (op == OP_INIT) {
+        while (batch < MAX_BATCH && run_sample(op, batch, columns, rows, bomb_percent, 0)*1e-9*batch < MIN_SAMPLE_TIME) {
+            batch *= 2;
+        }
+    }
+
+    int count = 0;
+    double sum = 0;
+    double sum_squares = 0;
+    double error = 1;
+    double start = now_seconds();
+    while (count < MAX_SAMPLES) {
+        double sample = run_sample(op, batch, columns, rows, bomb_percent, count + 1);
+        samples[count++] = sample;
+        sum += sample;
+        sum_squares += sample*sample;
+
+        if (count < MIN_SAMPLES) continue;
+        double mean = sum/count;
+        double variance = (sum_squares - sum*mean)/(count - 1);
+        error = variance > 0 ? sqrt(variance/count)/mean : 0;
+        if (error <= STABLE_ERROR || now_seconds() - start > MAX_MEASURE_TIME) break;
+    }
+
+    qsort(samples, count, sizeof(samples[0]), compare_doubles);
+    if (result_count >= MAX_RESULTS) return;
+    Bench_Result *result = &results[result_count++];
+    snprintf(result->name, sizeof(result->name), "%s", op_names[op]);
+    result->columns = columns;
+    result->rows = rows;
+    result->bomb_percent = bomb_percent;
+    result->samples = count;
+    result->median_ns = samples[count/2];
+    result->mean_ns = sum/count;
+    result->min_ns = samples[0];
+    result->error = error;
+}
+
+
+static void run_suite(void)
+{
+    static const struct {
+        int columns;
+        int rows;
+    } sizes[] = {
+        {8, 8},
+        {16, 16},
+        {25, 16},
+        {100, 100},
+        {1000, 1000},
+    };
+    static const float densities[] = {10, 15.625, 20.625};
+
+    for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+        int columns = sizes[i].columns;
+        int rows = sizes[i].rows;
+        for (size_t j = 0; j < sizeof(densities)/sizeof(densities[0]); j++) {
+            measure(OP_INIT, columns, rows, densities[j]);
+            measure(OP_GENERATE, columns, rows, densities[j]);
+            measure(OP_FLOOD_FILL, columns, rows, densities[j]);
+            measure(OP_REVEAL_ALL, columns, rows, densities[j]);
+            measure(OP_FLAG_ALL, columns, rows, densities[j]);
+            measure(OP_CHORD_ALL, columns, rows, densities[j]);
+        }
+    }
+    free(moves);
+    moves = NULL;
+    move_capacity = 0;
+}
+
+
+/* One result per line, so a baseline can be read back without a JSON parser */
+static void print_json(void)
+{
+    printf("{\n  \"results\": [\n");
+    for (int i = 0; i < result_count; i++) {
+        Bench_Result *r = &results[i];
+        printf("    {\"name\": \"%s\", \"columns\": %d, \"rows\": %d, \"bomb_percent\": %g, "
+               "\"samples\": %d, \"median_ns\": %.1f, \"mean_ns\": %.1f, \"min_ns\": %.1f, \"error\": %.4f}%s\n",
+               r->name, r->columns, r->rows, r->bomb_percent,
+               r->samples, r->median_ns, r->mean_ns, r->min_ns, r->error,
+               i + 1 < result_count ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+
+/* Compare medians against a baseline written by --json. Returns count of
+ * results slower than the baseline by more than the `tolerance` share and
+ * by more than `tolerance_ns` */
+static int compare_baseline(const char *file_path, double tolerance, double tolerance_ns)
+{
+    FILE *file = fopen(file_path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: could not open baseline %s\n", file_path);
+        exit(1);
+    }
+
+    int regressions = 0;
+    char line[512];
+    fprintf(stderr, "%-12s %11s %8s %14s %14s %8s\n",
+            "baseline", "size", "bombs %", "baseline ns", "current ns", "change");
+    while (fgets(line, sizeof(line), file) != NULL) {
+        Bench_Result base;
+        int matched = sscanf(line, " {\"name\": \"%31[^\"]\", \"columns\": %d, \"rows\": %d, \"bomb_percent\": %f, "
+                             "\"samples\": %d, \"median_ns\": %lf",
+                             base.name, &base.columns, &base.rows, &base.bomb_percent,
+                             &base.samples, &base.median_ns);
+        if (matched != 6) continue;
+
+        for (int i = 0; i < result_count; i++) {
+            Bench_Result *r = &results[i];
+            if (strcmp(r->name, base.name) != 0) continue;
+            if (r->columns != base.columns || r->rows != base.rows) continue;
+            if (fabsf(r->bomb_percent - base.bomb_percent) > 1e-3f) continue;
+
+            double change = r->median_ns/base.median_ns - 1;
+            bool is_regression = change > tolerance && r->median_ns - base.median_ns > tolerance_ns;
+            regressions += is_regression;
+            fprintf(stderr, "%-12s %5dx%-5d %8g %14.1f %14.1f %+7.1f%%%s\n",
+                    r->name, r->columns, r->rows, r->bomb_percent,
+                    base.median_ns, r->median_ns, change*100, is_regression ? " REGRESSION" : "");
+        }
+    }
+    fclose(file);
+    return regressions;
+}
+
+
+int main(int argc, char **argv)
+{
+    bool is_suite = false;
+    const char *baseline_path = NULL;
+    double tolerance = DEFAULT_TOLERANCE;
+    double tolerance_ns = DEFAULT_TOLERANCE_NS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            is_suite = true;
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            is_suite = true;
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--tolerance-ns") == 0 && i + 1 < argc) {
+            tolerance_ns = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--json] [--baseline <file>] [--tolerance <share>] "
+                            "[--tolerance-ns <ns>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (is_suite) {
+        run_suite();
+        print_json();
+        if (baseline_path != NULL && compare_baseline(baseline_path, tolerance, tolerance_ns) > 0) return 2;
+        return 0;
+    }
+
+    printf("%-12s %12s %12s %8s %12s %8s\n",
+           "first click", "generate ms", "open ms", "worker", "frame ms", "in frame");
+    bench_first_click(25, 16);
+    bench_first_click(100, 100);
+    bench_first_click(1000, 1000);
+    bench_first_click(4000, 4000);
+    bench_first_click(10000, 10000);
+    printf("\n");
+
+    printf("%-20s %10s %10s %14s %11s %9s\n",
+           "bomb placement", "legacy ms", "floyd ms", "sequential ms", "used", "speedup");
+    bench_bomb_placement(500, 500, 15.625);
+    bench_bomb_placement(500, 500, 90);
+    bench_bomb_placement(1000, 1000, 15.625);
+    bench_bomb_placement(1000, 1000, 50);
+    bench_bomb_placement(1000, 1000, 90);
+    bench_bomb_placement(1000, 1000, 99);
+    bench_bomb_placement(2000, 2000, 15.625);
+    bench_bomb_placement(2000, 2000, 90);
+    printf("\n");
+
+    printf("%-12s %10s %10s %10s %10s\n", "bombs around", "legacy ms", "scalar ms", "sse2 ms", "avx2 ms");
+    bench_bombs_around(25, 16);
+    bench_bombs_around(100, 100);
+    bench_bombs_around(1000, 1000);
+    bench_bombs_around(4000, 4000);
+    printf("\n");
+
+    printf("%-24s %8s %12s %12s %9s\n", "flood fill", "opened", "legacy ms", "worklist ms", "speedup");
+
+    make_serpentine_board(&pristine, 100, 100);
+    bench_flood_fill("serpentine 100x100", 1, 97);
+
+    make_serpentine_board(&pristine, 25, 16);
+    bench_flood_fill("serpentine 25x16", 1, 13);
+
+    board_init(&pristine, 100, 100, 0, 0);
+    board_generate(&pristine, 0, 0);
+    bench_flood_fill("empty 100x100", 99, 99);
+    printf("\n");
+
+    printf("%-20s %8s %10s %12s %12s %12s\n",
+           "solver", "no guess", "deduced", "M cells/s", "ms/game", "rescan ms");
+    bench_solver(16, 16, 15.625);
+    bench_solver(16, 16, 20.625);
+    bench_solver(25, 16, 15.625);
+    bench_solver(25, 16, 20.625);
+    printf("\n");
+
+    printf("%-20s %8s %10s %10s %10s %10s %12s %12s %12s\n", "probability", "won",
+           "computes", "components", "cached", "estimated", "ms", "ms 4 threads", "rescan ms");
+    bench_probability(16, 16, 15.625, PROBABILITY_GAMES);
+    bench_probability(16, 16, 20.625, PROBABILITY_GAMES);
+    bench_probability(25, 16, 15.625, PROBABILITY_GAMES);
+    bench_probability(25, 16, 20.625, PROBABILITY_GAMES);
+    bench_probability(1000, 1000, 15.625, PROBABILITY_BIG_GAMES);
+    printf("\n");
+
+    printf("%-20s %10s %10s %10s %12s %12s %9s\n",
+           "chord replay", "events", "chords", "opened", "per-cell us", "batched us", "ratio");
+    bench_chord_replay(16, 16, 15.625);
+    bench_chord_replay(30, 16, 20.625);
+    bench_chord_replay(100, 100, 15.625);
+    printf("\n");
+
+    int threads = no_guess_default_threads();
+    printf("%-12s %6s %8s %8s %10s %10s %10s %10s\n",
+           "no guess", "bombs", "threads", "found", "attempts", "p50 ms", "p99 ms", "max ms");
+    bench_no_guess(16, 16, 40, threads);
+    bench_no_guess(25, 16, 99, 1);
+    if (threads > 1) bench_no_guess(25, 16, 99, threads);
+
+    return 0;
+}
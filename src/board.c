@@ -0,0 +1,681 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HAS_AVX2_KERNEL 1
+#else
+#define HAS_AVX2_KERNEL 0
+#endif
+
+
+static uint64_t next_random(uint64_t *state)
+{
+    /* splitmix64 */
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Boards of at least this many cells don't fit in cache */
+#define SEQUENTIAL_PLACEMENT_MIN_CELLS (1 << 20)
+
+
+/* Uniform number in [0, range) without the bias of a plain modulo
+ * (Lemire's multiply-and-reject) */
+static uint32_t random_below(uint64_t *state, uint32_t range)
+{
+    uint64_t product = (next_random(state) >> 32) * range;
+    uint32_t low = (uint32_t)product;
+    if (low < range) {
+        uint32_t threshold = -range % range;
+        while (low < threshold) {
+            product = (next_random(state) >> 32) * range;
+            low = (uint32_t)product;
+        }
+    }
+    return product >> 32;
+}
+
+
+/* Index of the n-th cell that is not excluded. Excluded cells are sorted */
+static int skip_excluded(int n, const int *excluded, int excluded_count)
+{
+    for (int i = 0; i < excluded_count && excluded[i] <= n; i++) n++;
+    return n;
+}
+
+
+/* Floyd's sampling: picks exactly `bombs` distinct cells in O(bombs)
+ * random numbers no matter how dense the board is. The bomb bits
+ * themselves serve as the set of already chosen cells */
+static void place_bombs_floyd(Board *board, int bombs, const int *excluded, int excluded_count)
+{
+    int cells = board->columns*board->rows - excluded_count;
+    for (int j = cells - bombs; j < cells; j++) {
+        int cell_index = skip_excluded(random_below(&board->rng, j + 1), excluded, excluded_count);
+        if (cell_is_bomb(board->cells[cell_index])) cell_index = skip_excluded(j, excluded, excluded_count);
+        board->cells[cell_index] |= CELL_BOMB_BIT;
+    }
+}
+
+
+static bool is_excluded(int cell_index, const int *excluded, int excluded_count)
+{
+    for (int i = 0; i < excluded_count; i++) {
+        if (excluded[i] == cell_index) return true;
+    }
+    return false;
+}
+
+
+/* Floyd's sampling jumps all over the board, so on boards that do not fit
+ * in cache every bomb costs a cache miss. Here every cell instead becomes a
+ * bomb with a fixed probability in one sequential pass, four cells per
+ * random number, and the surplus or shortage is then fixed by removing
+ * or adding uniformly chosen bombs. Conditioned on its count an
+ * independent sample is uniform, and so is the fixed one */
+static void place_bombs_sequential(Board *board, int bombs, const int *excluded, int excluded_count)
+{
+    int cells = board->columns*board->rows;
+    uint32_t threshold = (double)bombs/(cells - excluded_count)*65536 + 0.5;
+
+    int placed = 0;
+    for (int i = 0; i < cells; i += 4) {
+        uint64_t random = next_random(&board->rng);
+        int group = cells - i < 4 ? cells - i : 4;
+        for (int k = 0; k < group; k++) {
+            bool is_bomb = (random & 0xFFFF) < threshold;
+            random >>= 16;
+            board->cells[i + k] |= is_bomb*CELL_BOMB_BIT;
+            placed += is_bomb;
+        }
+    }
+
+    for (int i = 0; i < excluded_count; i++) {
+        if (!cell_is_bomb(board->cells[excluded[i]])) continue;
+        board->cells[excluded[i]] &= ~CELL_BOMB_BIT;
+        placed--;
+    }
+    while (placed > bombs) {
+        int cell_index = random_below(&board->rng, cells);
+        if (!cell_is_bomb(board->cells[cell_index])) continue;
+        board->cells[cell_index] &= ~CELL_BOMB_BIT;
+        placed--;
+    }
+    while (placed < bombs) {
+        int cell_index = random_below(&board->rng, cells);
+        if (cell_is_bomb(board->cells[cell_index])) continue;
+        if (is_excluded(cell_index, excluded, excluded_count)) continue;
+        board->cells[cell_index] |= CELL_BOMB_BIT;
+        placed++;
+    }
+}
+
+
+placement_method board_placement_method(const Board *board, int bombs)
+{
+    int cells = board->columns*board->rows;
+    /* Sparse bombs would make the fix up loops search for too long */
+    if (cells >= SEQUENTIAL_PLACEMENT_MIN_CELLS && bombs >= cells/100) return PLACEMENT_SEQUENTIAL;
+    return PLACEMENT_FLOYD;
+}
+
+
+void board_place_bombs_method(Board *board, int bombs, const int *excluded, int excluded_count,
+                              placement_method method)
+{
+    if (method == PLACEMENT_AUTO) method = board_placement_method(board, bombs);
+    if (method == PLACEMENT_SEQUENTIAL) {
+        place_bombs_sequential(board, bombs, excluded, excluded_count);
+    } else {
+        place_bombs_floyd(board, bombs, excluded, excluded_count);
+    }
+}
+
+
+void board_place_bombs(Board *board, int bombs, const int *excluded, int excluded_count)
+{
+    board_place_bombs_method(board, bombs, excluded, excluded_count, PLACEMENT_AUTO);
+}
+
+
+/* Bombs around kernels.
+ *
+ * Every row is processed in two passes over the bomb bits: first the
+ * vertical sums of the rows above, current and below are stored into a
+ * row of bytes padded with a zero on both sides, then every count is the
+ * sum of three neighbouring vertical sums minus the cell's own bomb. Both
+ * passes are plain byte adds, so 16 (SSE2) or 32 (AVX2) cells are counted
+ * at once. Only the bombs around bits of the row are rewritten, so the
+ * bomb bits of the next row's "above" are never disturbed */
+
+static const cell empty_row[MAX_FIELD_COLUMNS] = {0};
+
+static inline uint8_t bomb_of(cell c)
+{
+    return (c & CELL_BOMB_BIT) >> 4;
+}
+
+static void bombs_around_row_scalar(cell *row, const cell *above, const cell *below, int columns, uint8_t *sums)
+{
+    sums[0] = 0;
+    sums[columns + 1] = 0;
+    for (int x = 0; x < columns; x++) {
+        sums[x + 1] = bomb_of(above[x]) + bomb_of(row[x]) + bomb_of(below[x]);
+    }
+    for (int x = 0; x < columns; x++) {
+        int bombs_around = sums[x] + sums[x + 1] + sums[x + 2] - bomb_of(row[x]);
+        row[x] = (row[x] & ~CELL_BOMBS_AROUND_MASK) | bombs_around;
+    }
+}
+
+#if defined(__SSE2__)
+static void bombs_around_row_sse2(cell *row, const cell *above, const cell *below, int columns, uint8_t *sums)
+{
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i keep = _mm_set1_epi8((char)~CELL_BOMBS_AROUND_MASK);
+
+    sums[0] = 0;
+    sums[columns + 1] = 0;
+    int x = 0;
+    for (; x + 16 <= columns; x += 16) {
+        __m128i a = _mm_and_si128(_mm_srli_epi16(_mm_loadu_si128((const __m128i*)(above + x)), 4), ones);
+        __m128i b = _mm_and_si128(_mm_srli_epi16(_mm_loadu_si128((const __m128i*)(row + x)), 4), ones);
+        __m128i c = _mm_and_si128(_mm_srli_epi16(_mm_loadu_si128((const __m128i*)(below + x)), 4), ones);
+        _mm_storeu_si128((__m128i*)(sums + x + 1), _mm_add_epi8(_mm_add_epi8(a, b), c));
+    }
+    for (; x < columns; x++) {
+        sums[x + 1] = bomb_of(above[x]) + bomb_of(row[x]) + bomb_of(below[x]);
+    }
+
+    x = 0;
+    for (; x + 16 <= columns; x += 16) {
+        __m128i cells = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i self = _mm_and_si128(_mm_srli_epi16(cells, 4), ones);
+        __m128i left = _mm_loadu_si128((const __m128i*)(sums + x));
+        __m128i middle = _mm_loadu_si128((const __m128i*)(sums + x + 1));
+        __m128i right = _mm_loadu_si128((const __m128i*)(sums + x + 2));
+        __m128i count = _mm_sub_epi8(_mm_add_epi8(_mm_add_epi8(left, middle), right), self);
+        _mm_storeu_si128((__m128i*)(row + x), _mm_or_si128(_mm_and_si128(cells, keep), count));
+    }
+    for (; x < columns; x++) {
+        int bombs_around = sums[x] + sums[x + 1] + sums[x + 2] - bomb_of(row[x]);
+        row[x] = (row[x] & ~CELL_BOMBS_AROUND_MASK) | bombs_around;
+    }
+}
+#endif // __SSE2__
+
+#if HAS_AVX2_KERNEL
+__attribute__((target("avx2")))
+static void bombs_around_row_avx2(cell *row, const cell *above, const cell *below, int columns, uint8_t *sums)
+{
+    const __m256i ones = _mm256_set1_epi8(1);
+    const __m256i keep = _mm256_set1_epi8((char)~CELL_BOMBS_AROUND_MASK);
+
+    sums[0] = 0;
+    sums[columns + 1] = 0;
+    int x = 0;
+    for (; x + 32 <= columns; x += 32) {
+        __m256i a = _mm256_and_si256(_mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(above + x)), 4), ones);
+        __m256i b = _mm256_and_si256(_mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(row + x)), 4), ones);
+        __m256i c = _mm256_and_si256(_mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(below + x)), 4), ones);
+        _mm256_storeu_si256((__m256i*)(sums + x + 1), _mm256_add_epi8(_mm256_add_epi8(a, b), c));
+    }
+    for (; x < columns; x++) {
+        sums[x + 1] = bomb_of(above[x]) + bomb_of(row[x]) + bomb_of(below[x]);
+    }
+
+    x = 0;
+    for (; x + 32 <= columns; x += 32) {
+        __m256i cells = _mm256_loadu_si256((const __m256i*)(row + x));
+        __m256i self = _mm256_and_si256(_mm256_srli_epi16(cells, 4), ones);
+        __m256i left = _mm256_loadu_si256((const __m256i*)(sums + x));
+        __m256i middle = _mm256_loadu_si256((const __m256i*)(sums + x + 1));
+        __m256i right = _mm256_loadu_si256((const __m256i*)(sums + x + 2));
+        __m256i count = _mm256_sub_epi8(_mm256_add_epi8(_mm256_add_epi8(left, middle), right), self);
+        _mm256_storeu_si256((__m256i*)(row + x), _mm256_or_si256(_mm256_and_si256(cells, keep), count));
+    }
+    for (; x < columns; x++) {
+        int bombs_around = sums[x] + sums[x + 1] + sums[x + 2] - bomb_of(row[x]);
+        row[x] = (row[x] & ~CELL_BOMBS_AROUND_MASK) | bombs_around;
+    }
+}
+#endif // HAS_AVX2_KERNEL
+
+
+bool board_simd_supported(simd_level level)
+{
+    switch (level) {
+    case SIMD_AUTO:
+    case SIMD_NONE:
+        return true;
+    case SIMD_SSE2:
+#if defined(__SSE2__)
+        return true;
+#else
+        return false;
+#endif
+    case SIMD_AVX2:
+#if HAS_AVX2_KERNEL
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+
+bool board_calc_bombs_around_simd(Board *board, simd_level level)
+{
+    if (level == SIMD_AUTO) {
+        if (board_simd_supported(SIMD_AVX2)) level = SIMD_AVX2;
+        else if (board_simd_supported(SIMD_SSE2)) level = SIMD_SSE2;
+        else level = SIMD_NONE;
+    }
+    if (!board_simd_supported(level)) return false;
+
+    void (*bombs_around_row)(cell*, const cell*, const cell*, int, uint8_t*) = bombs_around_row_scalar;
+#if defined(__SSE2__)
+    if (level == SIMD_SSE2) bombs_around_row = bombs_around_row_sse2;
+#endif
+#if HAS_AVX2_KERNEL
+    if (level == SIMD_AVX2) bombs_around_row = bombs_around_row_avx2;
+#endif
+
+    int columns = board->columns;
+    int rows = board->rows;
+    uint8_t sums[MAX_FIELD_COLUMNS + 2];
+    for (int y = 0; y < rows; y++) {
+        const cell *above = y > 0 ? &board->cells[(y - 1)*columns] : empty_row;
+        const cell *below = y < rows - 1 ? &board->cells[(y + 1)*columns] : empty_row;
+        bombs_around_row(&board->cells[y*columns], above, below, columns, sums);
+    }
+    return true;
+}
+
+
+void board_calc_bombs_around(Board *board)
+{
+    board_calc_bombs_around_simd(board, SIMD_AUTO);
+}
+
+
+static bool board_reserve(Board *board, int cells)
+{
+    if (cells <= board->capacity) return true;
+
+    cell *new_cells = realloc(board->cells, cells*sizeof(*board->cells));
+    if (new_cells == NULL) return false;
+    board->cells = new_cells;
+
+    board->capacity = cells;
+    return true;
+}
+
+
+bool board_init(Board *board, int columns, int rows, float bomb_percent, uint64_t seed)
+{
+    if (columns <= 0 || columns > MAX_FIELD_COLUMNS) return false;
+    if (rows <= 0 || rows > MAX_FIELD_ROWS) return false;
+    if (!board_reserve(board, columns*rows)) return false;
+
+    board->columns = columns;
+    board->rows = rows;
+    board->score = 0;
+    board->flags = 0;
+    board->status = BOARD_PLAYING;
+    board->seed = seed;
+    board->rng = seed;
+
+    /* Reset field */
+    memset(board->cells, cell_with_state(0, CLOSE), columns*rows*sizeof(*board->cells));
+
+    /* Bombs are placed by board_generate() on the first reveal, which
+     * keeps the 3x3 square around the first opened cell free of them */
+    int cells = columns*rows;
+    int max_bombs = cells > FIRST_CLICK_SAFE_CELLS ? cells - FIRST_CLICK_SAFE_CELLS : 0;
+    board->bombs = (double)cells*bomb_percent / 100;
+    if (board->bombs > max_bombs) board->bombs = max_bombs;
+    if (board->bombs < 0) board->bombs = 0;
+    board->closed_safe_cells = cells - board->bombs;
+    board->is_field_generated = false;
+    board->change_count = 0;
+    board->is_all_changed = true;
+
+    return true;
+}
+
+
+void board_generate(Board *board, int safe_x, int safe_y)
+{
+    int excluded[FIRST_CLICK_SAFE_CELLS];
+    int excluded_count = 0;
+    for (int y = safe_y - 1; y <= safe_y + 1; y++) {
+        for (int x = safe_x - 1; x <= safe_x + 1; x++) {
+            if (x < 0 || x >= board->columns || y < 0 || y >= board->rows) continue;
+            excluded[excluded_count++] = y*board->columns + x;
+        }
+    }
+
+    board_place_bombs(board, board->bombs, excluded, excluded_count);
+    board_calc_bombs_around(board);
+    board->is_field_generated = true;
+
+#ifdef DEBUG
+    for (int y = 0; y < board->rows; y++) {
+        for (int x = 0; x < board->columns; x++) {
+            cell c = board->cells[y*board->columns + x];
+            printf("%3d ", cell_is_bomb(c) ? -1 : cell_bombs_around(c));
+        }
+        printf("\n");
+    }
+#endif
+}
+
+
+bool board_copy(Board *dst, const Board *src)
+{
+    int cells = src->columns*src->rows;
+    if (!board_reserve(dst, cells)) return false;
+
+    dst->columns = src->columns;
+    dst->rows = src->rows;
+    dst->bombs = src->bombs;
+    dst->score = src->score;
+    dst->status = src->status;
+    dst->seed = src->seed;
+    dst->rng = src->rng;
+    dst->flags = src->flags;
+    dst->closed_safe_cells = src->closed_safe_cells;
+    dst->is_field_generated = src->is_field_generated;
+    dst->change_count = 0;
+    dst->is_all_changed = true;
+    memcpy(dst->cells, src->cells, cells*sizeof(*dst->cells));
+    return true;
+}
+
+
+void board_free(Board *board)
+{
+    free(board->cells);
+    free(board->fill_stack);
+    memset(board, 0, sizeof(*board));
+}
+
+
+static inline void mark_changed(Board *board, int cell_index)
+{
+    if (board->change_count < MAX_TRACKED_CHANGES) board->changes[board->change_count++] = cell_index;
+    else board->is_all_changed = true;
+}
+
+
+void board_clear_changes(Board *board)
+{
+    board->change_count = 0;
+    board->is_all_changed = false;
+}
+
+
+int board_flags(const Board *board)
+{
+    return board->flags;
+}
+
+
+static void push_fill_stack(Board *board, int *stack_size, int cell_index)
+{
+    if (*stack_size >= board->fill_stack_capacity) {
+        int capacity = board->fill_stack_capacity == 0 ? 256 : board->fill_stack_capacity*2;
+        int *fill_stack = realloc(board->fill_stack, capacity*sizeof(*board->fill_stack));
+        if (fill_stack == NULL) {
+            fprintf(stderr, "ERROR: could not grow flood fill stack to %d cells\n", capacity);
+            abort();
+        }
+        board->fill_stack = fill_stack;
+        board->fill_stack_capacity = capacity;
+    }
+    board->fill_stack[(*stack_size)++] = cell_index;
+}
+
+
+/* Flood fill from the opened empty cells already on the fill stack. Every
+ * cell is pushed at most once (when it gets opened), so the cost is
+ * proportional to the opened area */
+static int open_empty_cells(Board *board, int stack_size)
+{
+    int opened = 0;
+    while (stack_size > 0) {
+        int cell_index = board->fill_stack[--stack_size];
+        int x = cell_index % board->columns;
+        int y = cell_index / board->columns;
+
+        /* Iterate through the neighboring cells and open it */
+        for (int sy = -1; sy <= 1; sy++) {
+            for (int sx = -1; sx <= 1; sx++) {
+                if (sx == 0 && sy == 0) continue;
+                if (x + sx < 0 || x + sx >= board->columns) continue;
+                if (y + sy < 0 || y + sy >= board->rows) continue;
+                int neighbour_cell_index = (y + sy) * board->columns + (x + sx);
+                cell *neighbour = &board->cells[neighbour_cell_index];
+                if (cell_get_state(*neighbour) == OPEN) continue;
+
+                if (cell_get_state(*neighbour) == FLAG) board->flags--;
+                *neighbour = cell_with_state(*neighbour, OPEN);
+                mark_changed(board, neighbour_cell_index);
+                opened++;
+                if (cell_bombs_around(*neighbour) == 0) {
+                    push_fill_stack(board, &stack_size, neighbour_cell_index);
+                }
+            }
+        }
+    }
+    board->score += opened;
+    board->closed_safe_cells -= opened;
+    return opened;
+}
+
+
+static void process_lose(Board *board)
+{
+    for (int i = 0; i < board->columns*board->rows; i++) {
+        cell *c = &board->cells[i];
+        if (!cell_is_bomb(*c)) continue;
+        if (cell_get_state(*c) == FLAG) board->flags--;
+        *c = cell_with_state(*c, OPEN);
+    }
+    board->status = BOARD_LOST;
+    board->is_all_changed = true;
+}
+
+
+int board_reveal(Board *board, int x, int y)
+{
+    if (board->status != BOARD_PLAYING) return 0;
+    if (x < 0 || x >= board->columns || y < 0 || y >= board->rows) return 0;
+
+    int cell_index = y * board->columns + x;
+    cell *c = &board->cells[cell_index];
+    if (cell_get_state(*c) != CLOSE) return 0;
+
+    if (!board->is_field_generated) board_generate(board, x, y);
+
+    int opened = 1;
+    *c = cell_with_state(*c, OPEN);
+    mark_changed(board, cell_index);
+    if (cell_is_bomb(*c)) {
+        process_lose(board);
+        return opened;
+    }
+
+    board->score++;
+    board->closed_safe_cells--;
+    if (cell_bombs_around(*c) == 0) {
+        int stack_size = 0;
+        push_fill_stack(board, &stack_size, cell_index);
+        opened += open_empty_cells(board, stack_size);
+    }
+
+    if (board->closed_safe_cells == 0) board->status = BOARD_WON;
+    return opened;
+}
+
+
+int board_chord(Board *board, int x, int y)
+{
+    if (board->status != BOARD_PLAYING) return 0;
+    if (x < 0 || x >= board->columns || y < 0 || y >= board->rows) return 0;
+
+    cell c = board->cells[y*board->columns + x];
+    if (cell_get_state(c) != OPEN || cell_bombs_around(c) == 0) return 0;
+
+    int neighbours[8];
+    int neighbour_count = 0;
+    int flags = 0;
+    for (int sy = -1; sy <= 1; sy++) {
+        for (int sx = -1; sx <= 1; sx++) {
+            if (sx == 0 && sy == 0) continue;
+            if (x + sx < 0 || x + sx >= board->columns) continue;
+            if (y + sy < 0 || y + sy >= board->rows) continue;
+            int neighbour_cell_index = (y + sy)*board->columns + (x + sx);
+            cell_state state = cell_get_state(board->cells[neighbour_cell_index]);
+            if (state == FLAG) flags++;
+            else if (state == CLOSE) neighbours[neighbour_count++] = neighbour_cell_index;
+        }
+    }
+    if (flags != cell_bombs_around(c)) return 0;
+
+    /* Open every neighbour first and queue the empty ones, so the areas
+     * they start are filled in one pass and cells they share are visited
+     * once. A wrong flag loses the game after the whole batch */
+    int opened = 0;
+    int safe_opened = 0;
+    bool is_bomb_opened = false;
+    int stack_size = 0;
+    for (int i = 0; i < neighbour_count; i++) {
+        cell *neighbour = &board->cells[neighbours[i]];
+        *neighbour = cell_with_state(*neighbour, OPEN);
+        mark_changed(board, neighbours[i]);
+        opened++;
+        if (cell_is_bomb(*neighbour)) {
+            is_bomb_opened = true;
+        } else {
+            safe_opened++;
+            if (cell_bombs_around(*neighbour) == 0) push_fill_stack(board, &stack_size, neighbours[i]);
+        }
+    }
+    if (is_bomb_opened) {
+        process_lose(board);
+        return opened;
+    }
+
+    board->score += safe_opened;
+    board->closed_safe_cells -= safe_opened;
+    opened += open_empty_cells(board, stack_size);
+
+    if (board->closed_safe_cells == 0) board->status = BOARD_WON;
+    return opened;
+}
+
+
+void board_toggle_flag(Board *board, int x, int y)
+{
+    if (board->status != BOARD_PLAYING) return;
+    if (x < 0 || x >= board->columns || y < 0 || y >= board->rows) return;
+
+    int cell_index = y * board->columns + x;
+    cell *c = &board->cells[cell_index];
+    if (cell_get_state(*c) == CLOSE && board->flags < board->bombs) {
+        *c = cell_with_state(*c, FLAG);
+        board->flags++;
+        mark_changed(board, cell_index);
+    } else if (cell_get_state(*c) == FLAG) {
+        *c = cell_with_state(*c, CLOSE);
+        board->flags--;
+        mark_changed(board, cell_index);
+    }
+}
+
+
+board_status board_get_status(const Board *board)
+{
+    return board->status;
+}
+
+
+int board_3bv(const Board *board)
+{
+    int cells = board->columns*board->rows;
+    uint8_t *is_counted = calloc(cells, 1);
+    int *stack = malloc(cells*sizeof(*stack));
+    if (is_counted == NULL || stack == NULL) {
+        free(is_counted);
+        free(stack);
+        return -1;
+    }
+
+    /* Every empty area is one click, and marks the cells it opens */
+    int clicks = 0;
+    for (int i = 0; i < cells; i++) {
+        cell c = board->cells[i];
+        if (is_counted[i] || cell_is_bomb(c) || cell_bombs_around(c) != 0) continue;
+        clicks++;
+        int stack_size = 0;
+        is_counted[i] = 1;
+        stack[stack_size++] = i;
+        while (stack_size > 0) {
+            int cell_index = stack[--stack_size];
+            int x = cell_index % board->columns;
+            int y = cell_index / board->columns;
+            for (int sy = -1; sy <= 1; sy++) {
+                for (int sx = -1; sx <= 1; sx++) {
+                    if (x + sx < 0 || x + sx >= board->columns) continue;
+                    if (y + sy < 0 || y + sy >= board->rows) continue;
+                    int neighbour_index = (y + sy)*board->columns + (x + sx);
+                    if (is_counted[neighbour_index]) continue;
+                    is_counted[neighbour_index] = 1;
+                    if (cell_bombs_around(board->cells[neighbour_index]) == 0) stack[stack_size++] = neighbour_index;
+                }
+            }
+        }
+    }
+
+    /* The rest of the safe cells take a click each */
+    for (int i = 0; i < cells; i++) {
+        if (!is_counted[i] && !cell_is_bomb(board->cells[i])) clicks++;
+    }
+    free(is_counted);
+    free(stack);
+    return clicks;
+}
+
+
+uint64_t board_hash(const Board *board)
+{
+    /* FNV-1a */
+    uint64_t hash = 0xCBF29CE484222325ull;
+    const int counters[] = {
+        board->columns,
+        board->rows,
+        board->bombs,
+        board->score,
+        board->status,
+        board->flags,
+        board->closed_safe_cells,
+        board->is_field_generated,
+    };
+    const uint8_t *bytes = (const uint8_t *)counters;
+    for (size_t i = 0; i < sizeof(counters); i++) hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    for (int i = 0; i < board->columns*board->rows; i++) hash = (hash ^ board->cells[i]) * 0x100000001B3ull;
+    return hash;
+}
@@ -0,0 +1,164 @@
+#ifndef BOARD_H_
+#define BOARD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Headless board engine: everything needed to play a game of minesweeper
+ * without a window. All state lives in Board, so any number of boards can
+ * be simulated side by side. */
+
+#define MAX_FIELD_COLUMNS 10000
+#define MAX_FIELD_ROWS    10000
+
+/* The first opened cell and its neighbours never hold a bomb */
+#define FIRST_CLICK_SAFE_CELLS 9
+
+/* Boards of at least this many cells can take more than a frame to
+ * generate, the game generates them off the render thread */
+#define SLOW_GENERATION_MIN_CELLS (1 << 20)
+
+/* Changed cells are listed for redrawing up to this count, past it the
+ * whole board is marked as changed */
+#define MAX_TRACKED_CHANGES 4096
+
+typedef enum {
+    OPEN = 0,
+    CLOSE,
+    FLAG,
+    STATE_COUNT
+} cell_state;
+
+/* Every cell is packed into one byte:
+ *   bits 0-3  count of bombs around the cell (0-8)
+ *   bit  4    bomb
+ *   bits 5-6  cell_state */
+typedef uint8_t cell;
+
+#define CELL_BOMBS_AROUND_MASK 0x0F
+#define CELL_BOMB_BIT          0x10
+#define CELL_STATE_SHIFT       5
+#define CELL_STATE_MASK        (0x03 << CELL_STATE_SHIFT)
+
+static inline int cell_bombs_around(cell c)
+{
+    return c & CELL_BOMBS_AROUND_MASK;
+}
+
+static inline bool cell_is_bomb(cell c)
+{
+    return (c & CELL_BOMB_BIT) != 0;
+}
+
+static inline cell_state cell_get_state(cell c)
+{
+    return (cell_state)((c & CELL_STATE_MASK) >> CELL_STATE_SHIFT);
+}
+
+static inline cell cell_with_state(cell c, cell_state state)
+{
+    return (c & ~CELL_STATE_MASK) | (state << CELL_STATE_SHIFT);
+}
+
+typedef enum {
+    BOARD_PLAYING = 0,
+    BOARD_WON,
+    BOARD_LOST,
+} board_status;
+
+typedef enum {
+    SIMD_AUTO = 0,
+    SIMD_NONE,
+    SIMD_SSE2,
+    SIMD_AVX2,
+} simd_level;
+
+typedef enum {
+    PLACEMENT_AUTO = 0,
+    PLACEMENT_FLOYD,
+    PLACEMENT_SEQUENTIAL,
+} placement_method;
+
+typedef struct {
+    int columns;
+    int rows;
+    int bombs;
+    int score;
+    board_status status;
+    /* The seed given to board_init(), rng is advanced from it */
+    uint64_t seed;
+    uint64_t rng;
+
+    /* Running counters, kept in sync by every state transition */
+    int flags;
+    int closed_safe_cells;
+
+    /* Bombs are placed lazily, on the first board_reveal() */
+    bool is_field_generated;
+
+    /* Allocated on demand and reused while the board does not grow */
+    int capacity;
+    cell *cells;
+
+    /* Pending empty cells of the flood fill in board_reveal() */
+    int *fill_stack;
+    int fill_stack_capacity;
+
+    /* Cells changed since the last board_clear_changes() */
+    int changes[MAX_TRACKED_CHANGES];
+    int change_count;
+    bool is_all_changed;
+} Board;
+
+/* Clears the board for a new game. Zero-initialized Board is valid input.
+ * Returns false if the cells could not be allocated */
+bool board_init(Board *board, int columns, int rows, float bomb_percent, uint64_t seed);
+/* Place the bombs so that (safe_x, safe_y) opens an empty area. Called by
+ * the first board_reveal() */
+void board_generate(Board *board, int safe_x, int safe_y);
+bool board_copy(Board *dst, const Board *src);
+/* Set bomb bits of exactly `bombs` uniformly chosen cells of a board
+ * without bombs, skipping the sorted `excluded` cell indices, with Floyd's
+ * sampling or, on boards too big for the cache, one sequential pass.
+ * Counts are left for board_calc_bombs_around() */
+void board_place_bombs(Board *board, int bombs, const int *excluded, int excluded_count);
+/* Same with an explicit method. PLACEMENT_SEQUENTIAL needs at least 1%
+ * of the cells to be bombs to fix its count up quickly */
+void board_place_bombs_method(Board *board, int bombs, const int *excluded, int excluded_count,
+                              placement_method method);
+/* Method board_place_bombs() uses for that many bombs on the board */
+placement_method board_placement_method(const Board *board, int bombs);
+void board_free(Board *board);
+/* Recompute the bombs around counts of every cell from the bomb bits,
+ * using the widest SIMD kernel the CPU supports */
+void board_calc_bombs_around(Board *board);
+/* Same with an explicit kernel. Returns false if the CPU lacks it */
+bool board_calc_bombs_around_simd(Board *board, simd_level level);
+bool board_simd_supported(simd_level level);
+
+/* Open the cell at (x, y). Returns count of cells opened by this call */
+int board_reveal(Board *board, int x, int y);
+/* Chord the open number at (x, y): if as many of its neighbours are
+ * flagged as it counts, open all the other closed ones at once. Their
+ * empty areas are filled in one pass and the game is won or lost once,
+ * after the whole batch. Returns count of cells opened, 0 if the number
+ * is not satisfied */
+int board_chord(Board *board, int x, int y);
+void board_toggle_flag(Board *board, int x, int y);
+
+/* Forget the changed cells once they are redrawn */
+void board_clear_changes(Board *board);
+
+int board_flags(const Board *board);
+board_status board_get_status(const Board *board);
+
+/* 3BV of a generated board: the fewest clicks that win it, one per empty
+ * area plus one per safe cell no empty area opens. Returns -1 if it could
+ * not allocate */
+int board_3bv(const Board *board);
+
+/* Hash of everything that decides how the game goes on: size, cells and
+ * counters. Equal boards have equal hashes */
+uint64_t board_hash(const Board *board);
+
+#endif // BOARD_H_
@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "endless.h"
+
+#define CHUNK_INDEX_CAPACITY (2*MAX_LIVE_CHUNKS)
+#define EMPTY_SLOT           -1
+
+
+static uint64_t mix64(uint64_t z)
+{
+    /* splitmix64 finalizer */
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t chunk_key(int chunk_x, int chunk_y)
+{
+    return ((uint64_t)(uint32_t)chunk_x << 32) | (uint32_t)chunk_y;
+}
+
+static int floor_div(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a - 1) / b) - 1;
+}
+
+static bool is_chunk_touched(const Chunk *chunk)
+{
+    for (int i = 0; i < CHUNK_CELLS; i++) {
+        if (cell_get_state(chunk->cells[i]) != CLOSE) return true;
+    }
+    return false;
+}
+
+
+bool endless_init(Endless *world, float bomb_percent, uint64_t seed)
+{
+    if (world->chunks == NULL) {
+        world->chunks = malloc(MAX_LIVE_CHUNKS*sizeof(*world->chunks));
+        world->chunk_index = malloc(CHUNK_INDEX_CAPACITY*sizeof(*world->chunk_index));
+        if (world->chunks == NULL || world->chunk_index == NULL) {
+            endless_free(world);
+            return false;
+        }
+    }
+
+    world->seed = seed;
+    world->bomb_threshold = bomb_percent/100*65536;
+    world->score = 0;
+    world->flags = 0;
+    world->status = BOARD_PLAYING;
+
+    world->chunk_count = 0;
+    world->tick = 0;
+    world->last_chunk = EMPTY_SLOT;
+    for (int i = 0; i < CHUNK_INDEX_CAPACITY; i++) world->chunk_index[i] = EMPTY_SLOT;
+
+    world->record_count = 0;
+    world->next_record = 0;
+    world->forgotten_chunks = 0;
+    for (int i = 0; i < world->record_index_capacity; i++) world->record_index[i] = EMPTY_SLOT;
+
+    world->fill_stack_size = 0;
+    return true;
+}
+
+
+void endless_free(Endless *world)
+{
+    free(world->chunks);
+    free(world->chunk_index);
+    free(world->records);
+    free(world->record_index);
+    free(world->fill_stack);
+    memset(world, 0, sizeof(*world));
+}
+
+
+static uint64_t chunk_seed(const Endless *world, int chunk_x, int chunk_y)
+{
+    return mix64(world->seed ^ mix64(chunk_key(chunk_x, chunk_y)));
+}
+
+
+static bool is_bomb_in_chunk(const Endless *world, uint64_t seed, int x, int y)
+{
+    /* Keep the start of the world empty */
+    if (x >= -1 && x <= 1 && y >= -1 && y <= 1) return false;
+
+    int local = (y - floor_div(y, CHUNK_SIZE)*CHUNK_SIZE)*CHUNK_SIZE + (x - floor_div(x, CHUNK_SIZE)*CHUNK_SIZE);
+    return (mix64(seed + local*0x9E3779B97F4A7C15ull) & 0xFFFF) < world->bomb_threshold;
+}
+
+
+bool endless_is_bomb(const Endless *world, int x, int y)
+{
+    uint64_t seed = chunk_seed(world, floor_div(x, CHUNK_SIZE), floor_div(y, CHUNK_SIZE));
+    return is_bomb_in_chunk(world, seed, x, y);
+}
+
+
+static void generate_chunk(const Endless *world, Chunk *chunk)
+{
+    /* Bombs of the chunk with a ring of neighbouring chunks' cells around */
+    bool bombs[CHUNK_SIZE + 2][CHUNK_SIZE + 2];
+    int start_x = chunk->chunk_x*CHUNK_SIZE;
+    int start_y = chunk->chunk_y*CHUNK_SIZE;
+    uint64_t seed = chunk_seed(world, chunk->chunk_x, chunk->chunk_y);
+    for (int y = 0; y < CHUNK_SIZE + 2; y++) {
+        for (int x = 0; x < CHUNK_SIZE + 2; x++) {
+            bool is_inside = x >= 1 && x <= CHUNK_SIZE && y >= 1 && y <= CHUNK_SIZE;
+            int world_x = start_x + x - 1;
+            int world_y = start_y + y - 1;
+            bombs[y][x] = is_inside
+                ? is_bomb_in_chunk(world, seed, world_x, world_y)
+                : endless_is_bomb(world, world_x, world_y);
+        }
+    }
+
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            int bombs_around = 0;
+            for (int sy = 0; sy <= 2; sy++) {
+                for (int sx = 0; sx <= 2; sx++) {
+                    if (sx == 1 && sy == 1) continue;
+                    bombs_around += bombs[y + sy][x + sx];
+                }
+            }
+            cell c = cell_with_state(bombs_around, CLOSE);
+            if (bombs[y + 1][x + 1]) c |= CELL_BOMB_BIT;
+            chunk->cells[y*CHUNK_SIZE + x] = c;
+        }
+    }
+}
+
+
+static uint64_t chunk_key_of(const Endless *world, int chunk)
+{
+    return chunk_key(world->chunks[chunk].chunk_x, world->chunks[chunk].chunk_y);
+}
+
+static uint64_t record_key_of(const Endless *world, int record)
+{
+    return chunk_key(world->records[record].chunk_x, world->records[record].chunk_y);
+}
+
+
+/* Insert `value` into a linear probing index of power of two capacity */
+static void index_insert(int *index, int capacity, uint64_t key, int value)
+{
+    int mask = capacity - 1;
+    int slot = mix64(key) & mask;
+    while (index[slot] != EMPTY_SLOT) slot = (slot + 1) & mask;
+    index[slot] = value;
+}
+
+
+/* Remove `value` with backward shift deletion: the entries after it move
+ * back into the hole unless that would put them before their home slot,
+ * so lookups never need tombstones */
+static void index_remove(const Endless *world, int *index, int capacity, uint64_t key, int value,
+                         uint64_t (*key_of)(const Endless*, int))
+{
+    int mask = capacity - 1;
+    int slot = mix64(key) & mask;
+    while (index[slot] != value) slot = (slot + 1) & mask;
+
+    for (int next = (slot + 1) & mask; index[next] != EMPTY_SLOT; next = (next + 1) & mask) {
+        int home = mix64(key_of(world, index[next])) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            index[slot] = index[next];
+            slot = next;
+        }
+    }
+    index[slot] = EMPTY_SLOT;
+}
+
+
+static int find_record(const Endless *world, int chunk_x, int chunk_y)
+{
+    if (world->record_index_capacity == 0) return EMPTY_SLOT;
+    int mask = world->record_index_capacity - 1;
+    for (int slot = mix64(chunk_key(chunk_x, chunk_y)) & mask;; slot = (slot + 1) & mask) {
+        int i = world->record_index[slot];
+        if (i == EMPTY_SLOT) return EMPTY_SLOT;
+        if (world->records[i].chunk_x == chunk_x && world->records[i].chunk_y == chunk_y) return i;
+    }
+}
+
+
+static void remove_record(Endless *world, int record)
+{
+    index_remove(world, world->record_index, world->record_index_capacity,
+                 record_key_of(world, record), record, record_key_of);
+    world->records[record].is_saved = false;
+}
+
+
+/* Take a record for an evicted chunk: a new one while there is room, then
+ * the oldest one of the ring, forgetting the chunk it holds */
+static Chunk_Record *add_record(Endless *world, int chunk_x, int chunk_y)
+{
+    int record;
+    if (world->record_count < MAX_CHUNK_RECORDS) {
+        if (world->record_count >= world->record_capacity) {
+            int capacity = world->record_capacity == 0 ? 64 : world->record_capacity*2;
+            if (capacity > MAX_CHUNK_RECORDS) capacity = MAX_CHUNK_RECORDS;
+            Chunk_Record *records = realloc(world->records, capacity*sizeof(*records));
+            if (records == NULL) return NULL;
+            world->records = records;
+            world->record_capacity = capacity;
+        }
+        if ((world->record_count + 1)*2 > world->record_index_capacity) {
+            int capacity = world->record_index_capacity == 0 ? 128 : world->record_index_capacity*2;
+            int *record_index = realloc(world->record_index, capacity*sizeof(*record_index));
+            if (record_index == NULL) return NULL;
+            world->record_index = record_index;
+            world->record_index_capacity = capacity;
+            for (int i = 0; i < capacity; i++) world->record_index[i] = EMPTY_SLOT;
+            for (int i = 0; i < world->record_count; i++) {
+                if (world->records[i].is_saved) index_insert(record_index, capacity, record_key_of(world, i), i);
+            }
+        }
+        record = world->record_count++;
+    } else {
+        record = world->next_record;
+        world->next_record = (world->next_record + 1) % MAX_CHUNK_RECORDS;
+        Chunk_Record *oldest = &world->records[record];
+        if (oldest->is_saved) {
+            for (int i = 0; i < CHUNK_CELLS; i++) world->flags -= (oldest->flag[i/8] >> (i%8)) & 1;
+            remove_record(world, record);
+            world->forgotten_chunks++;
+        }
+    }
+
+    Chunk_Record *r = &world->records[record];
+    r->chunk_x = chunk_x;
+    r->chunk_y = chunk_y;
+    r->is_saved = true;
+    index_insert(world->record_index, world->record_index_capacity, chunk_key(chunk_x, chunk_y), record);
+    return r;
+}
+
+
+static void evict_chunk(Endless *world, Chunk *chunk)
+{
+    if (!is_chunk_touched(chunk)) return;
+
+    Chunk_Record *r = add_record(world, chunk->chunk_x, chunk->chunk_y);
+    if (r == NULL) {
+        fprintf(stderr, "ERROR: could not save evicted chunk %d %d\n", chunk->chunk_x, chunk->chunk_y);
+        abort();
+    }
+
+    memset(r->open, 0, sizeof(r->open));
+    memset(r->flag, 0, sizeof(r->flag));
+    for (int i = 0; i < CHUNK_CELLS; i++) {
+        cell_state state = cell_get_state(chunk->cells[i]);
+        if (state == OPEN) r->open[i/8] |= 1 << (i%8);
+        if (state == FLAG) r->flag[i/8] |= 1 << (i%8);
+    }
+}
+
+
+/* Apply the record of a chunk being loaded again. The record is dropped,
+ * the live chunk holds the state until its next eviction saves it anew */
+static void restore_chunk(Endless *world, Chunk *chunk)
+{
+    int record = find_record(world, chunk->chunk_x, chunk->chunk_y);
+    if (record == EMPTY_SLOT) return;
+
+    const Chunk_Record *r = &world->records[record];
+    for (int i = 0; i < CHUNK_CELLS; i++) {
+        if (r->open[i/8] & (1 << (i%8))) chunk->cells[i] = cell_with_state(chunk->cells[i], OPEN);
+        if (r->flag[i/8] & (1 << (i%8))) chunk->cells[i] = cell_with_state(chunk->cells[i], FLAG);
+    }
+    remove_record(world, record);
+}
+
+
+static Chunk *load_chunk(Endless *world, int chunk_x, int chunk_y)
+{
+    world->tick++;
+
+    Chunk *last = world->last_chunk == EMPTY_SLOT ? NULL : &world->chunks[world->last_chunk];
+    if (last != NULL && last->chunk_x == chunk_x && last->chunk_y == chunk_y) {
+        last->last_used = world->tick;
+        return last;
+    }
+
+    int slot = mix64(chunk_key(chunk_x, chunk_y)) & (CHUNK_INDEX_CAPACITY - 1);
+    for (;; slot = (slot + 1) & (CHUNK_INDEX_CAPACITY - 1)) {
+        int i = world->chunk_index[slot];
+        if (i == EMPTY_SLOT) break;
+        if (world->chunks[i].chunk_x == chunk_x && world->chunks[i].chunk_y == chunk_y) {
+            world->chunks[i].last_used = world->tick;
+            world->last_chunk = i;
+            return &world->chunks[i];
+        }
+    }
+
+    /* Not loaded: take a free chunk or the least recently used one */
+    int i;
+    if (world->chunk_count < MAX_LIVE_CHUNKS) {
+        i = world->chunk_count++;
+        world->chunk_index[slot] = i;
+    } else {
+        i = 0;
+        for (int j = 1; j < world->chunk_count; j++) {
+            if (world->chunks[j].last_used < world->chunks[i].last_used) i = j;
+        }
+        evict_chunk(world, &world->chunks[i]);
+        index_remove(world, world->chunk_index, CHUNK_INDEX_CAPACITY, chunk_key_of(world, i), i, chunk_key_of);
+        index_insert(world->chunk_index, CHUNK_INDEX_CAPACITY, chunk_key(chunk_x, chunk_y), i);
+    }
+
+    Chunk *chunk = &world->chunks[i];
+    chunk->chunk_x = chunk_x;
+    chunk->chunk_y = chunk_y;
+    chunk->last_used = world->tick;
+    generate_chunk(world, chunk);
+    restore_chunk(world, chunk);
+
+    world->last_chunk = i;
+    return chunk;
+}
+
+
+/* Pointer to the cell, valid until the next chunk is loaded */
+static cell *cell_at(Endless *world, int x, int y)
+{
+    int chunk_x = floor_div(x, CHUNK_SIZE);
+    int chunk_y = floor_div(y, CHUNK_SIZE);
+    Chunk *chunk = load_chunk(world, chunk_x, chunk_y);
+    return &chunk->cells[(y - chunk_y*CHUNK_SIZE)*CHUNK_SIZE + (x - chunk_x*CHUNK_SIZE)];
+}
+
+
+cell endless_get_cell(Endless *world, int x, int y)
+{
+    return *cell_at(world, x, y);
+}
+
+
+static void push_fill_stack(Endless *world, int x, int y)
+{
+    if (world->fill_stack_size + 2 > world->fill_stack_capacity) {
+        int capacity = world->fill_stack_capacity == 0 ? 256 : world->fill_stack_capacity*2;
+        int *fill_stack = realloc(world->fill_stack, capacity*sizeof(*world->fill_stack));
+        if (fill_stack == NULL) {
+            fprintf(stderr, "ERROR: could not grow flood fill stack to %d cells\n", capacity/2);
+            abort();
+        }
+        world->fill_stack = fill_stack;
+        world->fill_stack_capacity = capacity;
+    }
+    world->fill_stack[world->fill_stack_size++] = x;
+    world->fill_stack[world->fill_stack_size++] = y;
+}
+
+
+/* Same worklist flood fill as the board's, crossing chunk borders, from
+ * the opened empty cells already on the fill stack. It always ends: at the
+ * default density empty cells do not percolate */
+static int open_empty_cells(Endless *world)
+{
+    int opened = 0;
+    while (world->fill_stack_size > 0) {
+        int y = world->fill_stack[--world->fill_stack_size];
+        int x = world->fill_stack[--world->fill_stack_size];
+
+        for (int sy = -1; sy <= 1; sy++) {
+            for (int sx = -1; sx <= 1; sx++) {
+                if (sx == 0 && sy == 0) continue;
+                cell *neighbour = cell_at(world, x + sx, y + sy);
+                if (cell_get_state(*neighbour) == OPEN) continue;
+
+                if (cell_get_state(*neighbour) == FLAG) world->flags--;
+                *neighbour = cell_with_state(*neighbour, OPEN);
+                opened++;
+                if (cell_bombs_around(*neighbour) == 0) push_fill_stack(world, x + sx, y + sy);
+            }
+        }
+    }
+    world->score += opened;
+    return opened;
+}
+
+
+int endless_reveal(Endless *world, int x, int y)
+{
+    if (world->status != BOARD_PLAYING) return 0;
+
+    cell *c = cell_at(world, x, y);
+    if (cell_get_state(*c) != CLOSE) return 0;
+
+    int opened = 1;
+    *c = cell_with_state(*c, OPEN);
+    if (cell_is_bomb(*c)) {
+        world->status = BOARD_LOST;
+        return opened;
+    }
+
+    world->score++;
+    if (cell_bombs_around(*c) == 0) {
+        push_fill_stack(world, x, y);
+        opened += open_empty_cells(world);
+    }
+    return opened;
+}
+
+
+int endless_chord(Endless *world, int x, int y)
+{
+    if (world->status != BOARD_PLAYING) return 0;
+
+    cell c = *cell_at(world, x, y);
+    if (cell_get_state(c) != OPEN || cell_bombs_around(c) == 0) return 0;
+
+    int flags = 0;
+    for (int sy = -1; sy <= 1; sy++) {
+        for (int sx = -1; sx <= 1; sx++) {
+            if (cell_get_state(*cell_at(world, x + sx, y + sy)) == FLAG) flags++;
+        }
+    }
+    if (flags != cell_bombs_around(c)) return 0;
+
+    /* Batched like board_chord() */
+    int opened = 0;
+    bool is_bomb_opened = false;
+    for (int sy = -1; sy <= 1; sy++) {
+        for (int sx = -1; sx <= 1; sx++) {
+            cell *neighbour = cell_at(world, x + sx, y + sy);
+            if (cell_get_state(*neighbour) != CLOSE) continue;
+
+            *neighbour = cell_with_state(*neighbour, OPEN);
+            opened++;
+            if (cell_is_bomb(*neighbour)) {
+                is_bomb_opened = true;
+            } else {
+                world->score++;
+                if (cell_bombs_around(*neighbour) == 0) push_fill_stack(world, x + sx, y + sy);
+            }
+        }
+    }
+    if (is_bomb_opened) {
+        world->fill_stack_size = 0;
+        world->status = BOARD_LOST;
+        return opened;
+    }
+    return opened + open_empty_cells(world);
+}
+
+
+void endless_toggle_flag(Endless *world, int x, int y)
+{
+    if (world->status != BOARD_PLAYING) return;
+
+    cell *c = cell_at(world, x, y);
+    if (cell_get_state(*c) == CLOSE) {
+        *c = cell_with_state(*c, FLAG);
+        world->flags++;
+    } else if (cell_get_state(*c) == FLAG) {
+        *c = cell_with_state(*c, CLOSE);
+        world->flags--;
+    }
+}
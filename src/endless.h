@@ -0,0 +1,88 @@
+#ifndef ENDLESS_H_
+#define ENDLESS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "board.h"
+
+/* Endless mode: an unbounded field split into CHUNK_SIZE x CHUNK_SIZE
+ * chunks. The bombs of a chunk are a pure function of the world seed and
+ * the chunk coordinate, so chunks are only created when something looks
+ * at them. At most MAX_LIVE_CHUNKS are kept unpacked; the least recently
+ * used one is evicted to an open/flag bitmap (or dropped entirely if
+ * nothing in it was touched) and rebuilt from the seed when needed again.
+ *
+ * At most MAX_CHUNK_RECORDS bitmaps are kept, so memory stays bounded
+ * however far the player goes. Past that the chunk evicted longest ago is
+ * forgotten: it comes back closed and unflagged, as it was generated, and
+ * its flags are taken off the flag count. */
+
+#define CHUNK_SIZE        32
+#define CHUNK_CELLS       (CHUNK_SIZE*CHUNK_SIZE)
+#define MAX_LIVE_CHUNKS   1024
+/* About 17 MB of bitmaps */
+#define MAX_CHUNK_RECORDS (1 << 16)
+
+typedef struct {
+    int chunk_x;
+    int chunk_y;
+    uint64_t last_used;
+    cell cells[CHUNK_CELLS];
+} Chunk;
+
+/* What is left of an evicted chunk that the player touched */
+typedef struct {
+    int chunk_x;
+    int chunk_y;
+    /* False once the chunk is loaded again or forgotten */
+    bool is_saved;
+    uint8_t open[CHUNK_CELLS/8];
+    uint8_t flag[CHUNK_CELLS/8];
+} Chunk_Record;
+
+typedef struct {
+    uint64_t seed;
+    uint32_t bomb_threshold;
+    int score;
+    int flags;
+    board_status status;
+
+    /* Unpacked chunks and an open addressing index of them */
+    Chunk *chunks;
+    int chunk_count;
+    int *chunk_index;
+    uint64_t tick;
+    int last_chunk;
+
+    /* Evicted chunks, with an open addressing index. Once MAX_CHUNK_RECORDS
+     * are used it is a ring and next_record is the oldest one */
+    Chunk_Record *records;
+    int record_count;
+    int record_capacity;
+    int next_record;
+    /* Evicted chunks forgotten to keep the records bounded */
+    long forgotten_chunks;
+    int *record_index;
+    int record_index_capacity;
+
+    /* Pending empty cells of the flood fill, in world coordinates */
+    int *fill_stack;
+    int fill_stack_size;
+    int fill_stack_capacity;
+} Endless;
+
+/* Zero-initialized Endless is valid input. The cells around (0, 0) never
+ * hold a bomb so the first click there always opens an area */
+bool endless_init(Endless *world, float bomb_percent, uint64_t seed);
+void endless_free(Endless *world);
+
+bool endless_is_bomb(const Endless *world, int x, int y);
+cell endless_get_cell(Endless *world, int x, int y);
+
+/* Same semantics as board_reveal(), board_chord() and board_toggle_flag(),
+ * except that there is no flag limit and an endless game can't be won */
+int endless_reveal(Endless *world, int x, int y);
+int endless_chord(Endless *world, int x, int y);
+void endless_toggle_flag(Endless *world, int x, int y);
+
+#endif // ENDLESS_H_
@@ -1,17 +1,49 @@
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
 #include "raylib.h"
+#include "rlgl.h"
 
 #include "themes/frappe.h"
-
+#include "board.h"
+#include "endless.h"
+#include "replay.h"
+#include "no_guess.h"
+
+/* Generated by build.sh from assets/ */
+#include "assets/open_sans_regular_ttf.h"
+#include "assets/open_cell_wav.h"
+#include "assets/flag_png.h"
+#include "assets/clock_png.h"
+#include "assets/bomb_png.h"
+
+#define FPS                    30
 #define FACTOR                 100
 #define DEFAULT_SCREEN_HEIGHT (FACTOR * 9)
 #define DEFAULT_SCREEN_WIDTH  (FACTOR * 16)
 #define CELL_SIZE             50
 #define CELL_SIZE_PRESSED     (CELL_SIZE - 5)
 #define CELL_GAP              5
+#define CELL_STEP             (CELL_SIZE + CELL_GAP)
+
+/* Camera limits. MIN_ZOOM bounds the count of visible cells, so the frame
+ * cost depends on the screen size and not on the board size */
+#define MIN_ZOOM       0.25f
+#define MAX_ZOOM       2.0f
+#define ZOOM_STEP      1.1f
+/* Mouse movement after which a left press pans the field instead of
+ * opening a cell */
+#define DRAG_THRESHOLD 5
 
 #define LOGO_FONT_SIZE            80
 #define MENU_BUTTON_FONT_SIZE     60
@@ -22,20 +54,16 @@
 #define INFO_BAR_WIDTH            200
 #define INFO_BAR_GAP              20
 
-#define MAX_FIELD_COLUMNS    100
-#define MAX_FIELD_ROWS       100
 #define DEFAULT_BOMB_PERCENT 15.625
+#define MIN_CUSTOM_FIELD_SIZE 2
+#define MAX_BOMB_PERCENT      99
 
-#define FONT_FILEPATH            "assets/fonts/OpenSans-Regular.ttf"
-#define OPEN_CELL_SOUND_FILEPATH "assets/sounds/open_cell.wav"
-#define FLAG_ICON_FILEPATH       "assets/images/flag.png"
-#define CLOCK_ICON_FILEPATH      "assets/images/clock.png"
-#define BOMB_ICON_FILEPATH       "assets/images/bomb.png"
 
 
 typedef enum {
     MENU = 0,
     CHOOSE_DIFFICULTY,
+    CHOOSE_CUSTOM_SIZE,
     GAME,
     PAUSE,
     WIN,
@@ -45,8 +73,18 @@ typedef enum {
 
 game_state current_state = MENU;
 
-int cell_right_pressed_index = -1;
-int cell_left_pressed_index = -1;
+typedef struct {
+    int x;
+    int y;
+} cell_position;
+
+/* No cell was pressed yet; endless coordinates can be negative */
+cell_position cell_right_pressed = {INT_MIN, INT_MIN};
+cell_position cell_left_pressed = {INT_MIN, INT_MIN};
+cell_position cell_middle_pressed = {INT_MIN, INT_MIN};
+/* Both buttons were held together: the first of them released chords and
+ * neither reveals nor flags until both are up */
+bool is_chording = false;
 
 /* Fonts */
 Font logo_font;
@@ -54,45 +92,322 @@ Font menu_font;
 Font field_font;
 Font end_game_button_font;
 
-/* Images and textures */
-Image flag_icon_image;
+/* Textures, the images they come from are only kept while loading */
 Texture2D flag_icon_texture;
-
-Image clock_icon_image;
 Texture2D clock_icon_texture;
 
-Image bomb_icon_image;
-Texture2D bomb_icon_texture;
+/* Every look of a cell in one texture, so the whole field is drawn as a
+ * single batch of quads */
+typedef enum {
+    TILE_CLOSED = 0,
+    TILE_CLOSED_HOVER,
+    TILE_FLAG,
+    TILE_FLAG_HOVER,
+    TILE_BOMB,
+    TILE_EMPTY,
+    TILE_BACKGROUND,
+    TILE_DIGIT_1,
+    TILE_COUNT = TILE_DIGIT_1 + 8,
+} atlas_tile;
+
+/* Tiles are padded with their background so that filtering a zoomed
+ * cell never samples the neighbouring tile */
+#define ATLAS_PADDING   2
+#define ATLAS_TILE_STEP (CELL_SIZE + 2*ATLAS_PADDING)
+
+Texture2D cell_atlas_texture;
+
+/* The visible part of the field is kept in a render texture, drawn with
+ * field_cache_camera and with field_cache_highlight hovered */
+RenderTexture2D field_cache = {0};
+bool is_field_cache_valid = false;
+Camera2D field_cache_camera = {0};
+cell_position field_cache_highlight = {INT_MIN, INT_MIN};
+bool is_field_cache_highlight_pressed = false;
 
 /* Sounds */
 Sound open_cell_sound;
 
 
 float seconds_played = 0;
-int score = 0;
+/* GetTime() of the last clock update. The frame time can't be used for
+ * the clock, it includes the wait for events before the frame */
+double clock_tick_time = 0;
+bool is_clock_ticking = false;
 
-bool is_field_generated = false;
+int field_columns = 8;
+int field_rows    = 8;
+float bomb_percent = DEFAULT_BOMB_PERCENT;
+/* Bounded games of up to NO_GUESS_MAX_CELLS cells are generated by
+ * no_guess_generate() on the first click */
+bool is_no_guess = false;
+int no_guess_threads = 1;
+
+/* Every game is made from its own seed so a recording can rebuild it.
+ * The seeds are a splitmix64 sequence started from the time */
+static uint64_t seed_state = 0;
+
+/* Recording of the bounded game being played, saved to recording_dir when
+ * the game ends. Endless games are not recorded */
+static Recording recording = {0};
+const char *recording_dir = "recordings";
+
+/* The board being played and a spare one the next game is prepared in */
+static Board boards[2] = {0};
+static Board *board = &boards[0];
+static Board *spare_board = &boards[1];
+
+/* Next board pipeline */
+typedef struct {
+    Board *board;
+    int columns;
+    int rows;
+    float bomb_percent;
+    uint64_t seed;
+    bool ok;
+} board_job;
+
+static pthread_t next_board_thread;
+static board_job next_board_job;
+static bool is_next_board_pending = false;
+
+/* First click generation of boards too big for a frame: the worker places
+ * the bombs while frames go on, the clicked cell is opened when it is done */
+typedef struct {
+    Board *board;
+    int safe_x;
+    int safe_y;
+    bool is_done;
+} generation_job;
+
+static pthread_t generation_thread;
+static generation_job generation = {0};
+static pthread_mutex_t generation_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool is_generating = false;
+
+/* Endless mode */
+bool is_endless = false;
+static Endless world = {0};
+
+/* Camera over the field. In field space cell (x, y) starts at
+ * (x*CELL_STEP, y*CELL_STEP) */
+Camera2D camera = {0};
+Vector2 drag_start_position;
+bool is_dragging_field = false;
+
+/* Visible part of the field */
+typedef struct {
+    /* Screen area the field is drawn in */
+    Rectangle viewport;
+    /* The field on screen, clipped to the viewport */
+    Rectangle bounds;
+    /* Range of cells that intersect the viewport */
+    int first_x;
+    int first_y;
+    int columns;
+    int rows;
+} field_view;
+
+/* Frame timing, shown with F3 */
+typedef enum {
+    PHASE_INPUT = 0,
+    PHASE_INIT_FIELD,
+    PHASE_REVEAL,
+    PHASE_RENDER_FIELD,
+    PHASE_HUD,
+    PHASE_END_DRAWING,
+    PHASE_COUNT,
+} frame_phase;
+
+const char *phase_names[PHASE_COUNT] = {
+    [PHASE_INPUT]        = "input",
+    [PHASE_INIT_FIELD]   = "init_field",
+    [PHASE_REVEAL]       = "reveal",
+    [PHASE_RENDER_FIELD] = "render_field",
+    [PHASE_HUD]          = "hud",
+    [PHASE_END_DRAWING]  = "end_drawing",
+};
+
+typedef struct {
+    /* From the start of the frame to the start of the next one */
+    double frame;
+    /* The frame without EndDrawing(), which waits for the next frame */
+    double busy;
+    double phases[PHASE_COUNT];
+} Frame_Timing;
+
+/* Frames in the rolling stats of the overlay */
+#define TIMING_WINDOW      (FPS*4)
+/* Raw samples kept for the CSV export, the oldest are overwritten */
+#define MAX_TIMING_SAMPLES (FPS*60*10)
+
+Frame_Timing timing_samples[MAX_TIMING_SAMPLES];
+long timing_sample_count = 0;
+Frame_Timing current_timing = {0};
+bool is_timing_overlay_shown = false;
+
+/* Custom size menu */
+int custom_columns = 100;
+int custom_rows    = 100;
+int custom_bomb_percent = 16;
+int *custom_selected_size = &custom_columns;
+
+/* Everything a player can ask for outside of the field */
+typedef enum {
+    ACTION_PLAY = 0,
+    ACTION_EXIT,
+    ACTION_EASY,
+    ACTION_MEDIUM,
+    ACTION_HARD,
+    ACTION_CUSTOM,
+    ACTION_ENDLESS,
+    ACTION_SELECT_COLUMNS,
+    ACTION_SELECT_ROWS,
+    ACTION_SELECT_BOMB_PERCENT,
+    ACTION_NEXT_SIZE_FIELD,
+    ACTION_START_CUSTOM,
+    ACTION_BACK,
+    ACTION_PLAY_AGAIN,
+    ACTION_CHANGE_DIFFICULTY,
+    ACTION_PAUSE,
+    ACTION_CONTINUE,
+    ACTION_TOGGLE_NO_GUESS,
+} menu_action;
 
 typedef enum {
-    OPEN = 0,
-    CLOSE,
-    FLAG,
-    STATE_COUNT
-} cell_state;
-
-int field_columns = MAX_FIELD_COLUMNS;
-int field_rows    = MAX_FIELD_ROWS;
-static int field[MAX_FIELD_COLUMNS*MAX_FIELD_ROWS] = {0};
-static cell_state state_field[MAX_FIELD_COLUMNS*MAX_FIELD_ROWS] = {0};
-float bomb_percent = DEFAULT_BOMB_PERCENT;
-int bombs;
+    COMMAND_REVEAL = 0,
+    COMMAND_TOGGLE_FLAG,
+    COMMAND_CHORD,
+    COMMAND_MENU_ACTION,
+    COMMAND_TYPE_DIGIT,
+    COMMAND_ERASE_DIGIT,
+} command_type;
+
+/* Input is sampled once per frame into a queue of commands, step_game()
+ * applies them and only then the frame is drawn */
+typedef struct {
+    command_type type;
+    /* Cell of COMMAND_REVEAL, COMMAND_TOGGLE_FLAG and COMMAND_CHORD */
+    int x;
+    int y;
+    /* menu_action of COMMAND_MENU_ACTION, digit of COMMAND_TYPE_DIGIT */
+    int value;
+} Command;
+
+#define MAX_COMMANDS 64
+
+Command command_queue[MAX_COMMANDS];
+int command_count = 0;
+
+/* Clickable text, laid out the same way for input and for drawing */
+typedef struct {
+    /* Longer labels are cut to fit */
+    char text[64];
+    Font font;
+    int font_size;
+    Color color;
+    Rectangle rect;
+    menu_action action;
+} Button;
+
+#define MAX_BUTTONS 8
+
+
+void add_phase_time(frame_phase phase, double start)
+{
+    current_timing.phases[phase] += GetTime() - start;
+}
+
+
+void finish_frame_timing(double frame, double busy)
+{
+    current_timing.frame = frame;
+    current_timing.busy = busy;
+    timing_samples[timing_sample_count % MAX_TIMING_SAMPLES] = current_timing;
+    timing_sample_count++;
+    memset(&current_timing, 0, sizeof(current_timing));
+}
 
 
-int random_number(int minimum_number, int max_number)
+int compare_doubles(const void *a, const void *b)
 {
-    return rand() % (max_number + 1 - minimum_number) + minimum_number;
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
 }
 
+
+/* min/avg/p99 in milliseconds of one field of the last TIMING_WINDOW samples */
+void timing_stats(size_t field_offset, double *min, double *avg, double *p99)
+{
+    static double values[TIMING_WINDOW];
+    int count = timing_sample_count < TIMING_WINDOW ? timing_sample_count : TIMING_WINDOW;
+    double sum = 0;
+    for (int i = 0; i < count; i++) {
+        long sample = (timing_sample_count - 1 - i) % MAX_TIMING_SAMPLES;
+        values[i] = *(double *)((char *)&timing_samples[sample] + field_offset) * 1000;
+        sum += values[i];
+    }
+    if (count == 0) {
+        *min = *avg = *p99 = 0;
+        return;
+    }
+    qsort(values, count, sizeof(values[0]), compare_doubles);
+    *min = values[0];
+    *avg = sum / count;
+    *p99 = values[(count - 1) * 99 / 100];
+}
+
+
+void render_timing_overlay(void)
+{
+    const int font_size = 20;
+    const int line_height = 22;
+    int lines = 3 + PHASE_COUNT;
+    DrawRectangle(10, 10, 420, 20 + lines*line_height, Fade(BACKGROUND_COLOR, 0.85f));
+
+    int y = 20;
+    DrawText(TextFormat("%-12s %6s %7s %7s", "ms", "min", "avg", "p99"), 20, y, font_size, TEXT_COLOR);
+    y += line_height;
+
+    double min, avg, p99;
+    timing_stats(offsetof(Frame_Timing, frame), &min, &avg, &p99);
+    DrawText(TextFormat("%-12s %6.2f %7.2f %7.2f", "frame", min, avg, p99), 20, y, font_size, TEXT_COLOR);
+    y += line_height;
+    timing_stats(offsetof(Frame_Timing, busy), &min, &avg, &p99);
+    DrawText(TextFormat("%-12s %6.2f %7.2f %7.2f", "busy", min, avg, p99), 20, y, font_size, TEXT_COLOR);
+    y += line_height;
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        timing_stats(offsetof(Frame_Timing, phases) + phase*sizeof(double), &min, &avg, &p99);
+        DrawText(TextFormat("%-12s %6.2f %7.2f %7.2f", phase_names[phase], min, avg, p99),
+                 20, y, font_size, CELL_TEXT_COLOR);
+        y += line_height;
+    }
+}
+
+
+/* Write the kept samples, oldest first */
+bool export_timing_csv(const char *file_path)
+{
+    FILE *file = fopen(file_path, "w");
+    if (file == NULL) return false;
+
+    fprintf(file, "frame,frame_ms,busy_ms");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) fprintf(file, ",%s_ms", phase_names[phase]);
+    fprintf(file, "\n");
+
+    long first = timing_sample_count > MAX_TIMING_SAMPLES ? timing_sample_count - MAX_TIMING_SAMPLES : 0;
+    for (long i = first; i < timing_sample_count; i++) {
+        Frame_Timing *sample = &timing_samples[i % MAX_TIMING_SAMPLES];
+        fprintf(file, "%ld,%.4f,%.4f", i, sample->frame*1000, sample->busy*1000);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) fprintf(file, ",%.4f", sample->phases[phase]*1000);
+        fprintf(file, "\n");
+    }
+    return fclose(file) == 0;
+}
+
+
 bool is_mouse_or_key_released(int mouse_button, int key)
 {
     return IsMouseButtonReleased(mouse_button) || IsKeyReleased(key);
@@ -127,18 +442,32 @@ Rectangle draw_text_centered(const char *text, Font font, int font_size, Color t
     return text_rect;
 }
 
-Rectangle draw_text(const char *text, Font font, int font_size, Color text_color, Vector2 text_position)
+Button make_button(const char *text, Font font, int font_size, Color color, Vector2 position, menu_action action)
 {
-    Vector2 text_size = MeasureTextEx(font, text, font_size, 1);
-    DrawTextEx(font, text, text_position, font_size, 1, text_color);
-
-    Rectangle text_rect = {
-        .x = text_position.x,
-        .y = text_position.y,
-        .width = text_size.x,
-        .height = text_size.y
+    Button button = {
+        .font = font,
+        .font_size = font_size,
+        .color = color,
+        .action = action,
     };
-    return text_rect;
+    snprintf(button.text, sizeof(button.text), "%s", text);
+    Vector2 text_size = MeasureTextEx(font, button.text, font_size, 1);
+    button.rect = CLITERAL(Rectangle){position.x, position.y, text_size.x, text_size.y};
+    return button;
+}
+
+Button make_button_centered(const char *text, Font font, int font_size, Color color, Vector2 center, menu_action action)
+{
+    Button button = make_button(text, font, font_size, color, center, action);
+    button.rect.x -= button.rect.width/2;
+    button.rect.y -= button.rect.height/2;
+    return button;
+}
+
+
+void push_command(Command command)
+{
+    if (command_count < MAX_COMMANDS) command_queue[command_count++] = command;
 }
 
 
@@ -152,319 +481,538 @@ void render_menu(int screen_width, int screen_height)
         TEXT_COLOR,
         CLITERAL(Vector2){screen_width/2, screen_height/2 - 100}
     );
-    /* Draw buttons */
+}
 
-    /* Draw play button */
-    Rectangle play_rect = draw_text_centered(
-        "Play",
-        menu_font,
-        MENU_BUTTON_FONT_SIZE,
-        TEXT_COLOR,
-        CLITERAL(Vector2){screen_width/2, screen_height/2}
-    );
 
-    /* Draw exit button */
-    Rectangle exit_rect = draw_text_centered(
-        "Exit",
-        menu_font,
-        MENU_BUTTON_FONT_SIZE,
-        TEXT_COLOR,
-        CLITERAL(Vector2){screen_width/2, screen_height/2 + 100}
-    );
+void *prepare_next_board(void *arg)
+{
+    board_job *job = arg;
+    job->ok = board_init(job->board, job->columns, job->rows, job->bomb_percent, job->seed);
+    return NULL;
+}
 
-    /* Check mouse click */
-    if (is_mouse_or_key_released(MOUSE_BUTTON_LEFT, KEY_Z)) {
-        Vector2 mouse_position = GetMousePosition();
-        if (CheckCollisionPointRec(mouse_position, play_rect)) {
-            current_state = CHOOSE_DIFFICULTY;
-        } else if (CheckCollisionPointRec(mouse_position, exit_rect)) {
-            current_state = QUIT;
-        }
-    }
+
+uint64_t next_game_seed(void)
+{
+    uint64_t z = (seed_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
 }
 
 
-void init_field(void)
+/* Start clearing the spare board for the next game with the same settings
+ * in the background, while the end game screen is shown */
+void start_next_board(void)
 {
-    /* Reset field */
-    for (int i = 0; i < MAX_FIELD_ROWS*MAX_FIELD_COLUMNS; i++) {
-        field[i] = 0;
-        state_field[i] = CLOSE;
-    }
+    if (is_next_board_pending) return;
+    next_board_job = CLITERAL(board_job){
+        .board = spare_board,
+        .columns = field_columns,
+        .rows = field_rows,
+        .bomb_percent = bomb_percent,
+        .seed = next_game_seed(),
+    };
+    is_next_board_pending = pthread_create(&next_board_thread, NULL, prepare_next_board, &next_board_job) == 0;
+}
+
+
+void *generate_field(void *arg)
+{
+    generation_job *job = arg;
+    board_generate(job->board, job->safe_x, job->safe_y);
+    pthread_mutex_lock(&generation_mutex);
+    job->is_done = true;
+    pthread_mutex_unlock(&generation_mutex);
+    return NULL;
+}
+
+
+/* Generate the board for a first click at (x, y) on a worker. Returns
+ * false if the worker could not be started */
+bool start_field_generation(int x, int y)
+{
+    generation = CLITERAL(generation_job){.board = board, .safe_x = x, .safe_y = y};
+    is_generating = pthread_create(&generation_thread, NULL, generate_field, &generation) == 0;
+    return is_generating;
+}
+
+
+bool is_field_generation_done(void)
+{
+    pthread_mutex_lock(&generation_mutex);
+    bool is_done = generation.is_done;
+    pthread_mutex_unlock(&generation_mutex);
+    return is_done;
+}
+
 
-    /* Set bombs at field */
-    int cells = field_columns*field_rows;;
-    bombs = cells*bomb_percent / 100;
-    for (int i = 0; i < bombs; i++) {
-        int cell_index = random_number(0, cells - 1);
-        while (field[cell_index] == -1) cell_index = random_number(0, cells - 1);
-        field[cell_index] = -1;
+/* Wait for the worker and open the clicked cell, so the board matches the
+ * recorded reveal even if the game is left before the next frame */
+void finish_field_generation(void)
+{
+    if (!is_generating) return;
+    pthread_join(generation_thread, NULL);
+    is_generating = false;
+    board_reveal(board, generation.safe_x, generation.safe_y);
+}
+
+
+/* Wait for the next board. Returns true if it is ready to be played */
+bool finish_next_board(void)
+{
+    if (!is_next_board_pending) return false;
+    pthread_join(next_board_thread, NULL);
+    is_next_board_pending = false;
+    return next_board_job.ok;
+}
+
+
+Rectangle field_viewport(int screen_width, int screen_height)
+{
+    /* The right part of the screen is left for the info bar */
+    return CLITERAL(Rectangle){
+        .x = INFO_BAR_GAP,
+        .y = INFO_BAR_GAP,
+        .width = screen_width - 2*INFO_BAR_WIDTH - 2*INFO_BAR_GAP,
+        .height = screen_height - 2*INFO_BAR_GAP
+    };
+}
+
+
+/* Center the camera on the field and zoom out until it fits, as far as
+ * MIN_ZOOM allows */
+void reset_camera(void)
+{
+    Rectangle viewport = field_viewport(GetScreenWidth(), GetScreenHeight());
+    camera.offset = CLITERAL(Vector2){viewport.x + viewport.width/2, viewport.y + viewport.height/2};
+    camera.rotation = 0;
+    is_field_cache_valid = false;
+    if (is_endless) {
+        camera.target = CLITERAL(Vector2){CELL_SIZE/2, CELL_SIZE/2};
+        camera.zoom = 1;
+        return;
     }
 
-    /* Calc bombs around cells */
-    for (int y = 0; y < field_rows; y++) {
-        for (int x = 0; x < field_columns; x++) {
-            if (field[y*field_columns + x] == -1) continue;
+    float field_width = board->columns*CELL_STEP - CELL_GAP;
+    float field_height = board->rows*CELL_STEP - CELL_GAP;
+    camera.target = CLITERAL(Vector2){field_width/2, field_height/2};
+    camera.zoom = fminf(viewport.width/field_width, viewport.height/field_height);
+    camera.zoom = fmaxf(fminf(camera.zoom, 1), MIN_ZOOM);
+}
 
-            int bombs_around = 0;
-            for (int sy = -1; sy <= 1; sy++) {
-                for (int sx = -1; sx <= 1; sx++) {
-                     if (sx == 0 && sy == 0) continue;
-                     if (x + sx < 0 || x + sx >= field_columns) continue;
-                     if (y + sy < 0 || y + sy >= field_rows) continue;
 
-                     if (field[(sy+y)*field_columns + (sx+x)] == -1) bombs_around += 1;
-                }
-            }
-            field[y*field_columns + x] = bombs_around;
-        }
+bool init_endless_field(void)
+{
+    double start = GetTime();
+    bool ok = endless_init(&world, DEFAULT_BOMB_PERCENT, next_game_seed());
+    add_phase_time(PHASE_INIT_FIELD, start);
+    if (!ok) {
+        TraceLog(LOG_WARNING, "Could not allocate endless field");
+        return false;
     }
+    reset_camera();
+    return true;
+}
 
-#ifdef DEBUG
-    for (int y = 0; y < field_rows; y++) {
-        for (int x = 0; x < field_columns; x++) {
-            printf("%3d ", field[y*field_columns + x]);
+
+/* Field access for both the bounded board and the endless world */
+cell field_get_cell(int x, int y)
+{
+    if (is_endless) return endless_get_cell(&world, x, y);
+    return board->cells[y*board->columns + x];
+}
+
+bool is_no_guess_size(int columns, int rows)
+{
+    return columns*rows <= NO_GUESS_MAX_CELLS;
+}
+
+/* No guessing is on and applies to the board being played */
+bool is_no_guess_field(void)
+{
+    return is_no_guess && !is_endless && is_no_guess_size(board->columns, board->rows);
+}
+
+int field_reveal(int x, int y)
+{
+    if (is_endless) return endless_reveal(&world, x, y);
+    bool is_inside = x >= 0 && x < board->columns && y >= 0 && y < board->rows;
+    if (is_no_guess_field() && !board->is_field_generated && is_inside &&
+        cell_get_state(board->cells[y*board->columns + x]) == CLOSE) {
+        int attempts;
+        if (!no_guess_generate(board, x, y, no_guess_threads, &attempts)) {
+            TraceLog(LOG_WARNING, "No board out of %d could be won without guessing", attempts);
         }
-        printf("\n");
     }
-#endif
+    return board_reveal(board, x, y);
+}
 
+int field_chord(int x, int y)
+{
+    if (is_endless) return endless_chord(&world, x, y);
+    return board_chord(board, x, y);
 }
 
+void field_toggle_flag(int x, int y)
+{
+    if (is_endless) endless_toggle_flag(&world, x, y);
+    else board_toggle_flag(board, x, y);
+}
 
-int flags(void)
+board_status field_status(void)
 {
-    int flags = 0;
-    for (int i = 0; i < field_rows*field_columns; i++) {
-        if (state_field[i] == FLAG) flags++;
-    }
-    return flags;
+    return is_endless ? world.status : board_get_status(board);
 }
 
+bool is_field_started(void)
+{
+    return is_endless || is_generating || board->is_field_generated;
+}
 
-void open_empty_cells(void)
+bool is_same_cell(cell_position a, int x, int y)
 {
-    bool run = true;
-    while (run) {
-        run = false;
-        for (int y = 0; y < field_rows; y++) {
-            for (int x = 0; x < field_columns; x++) {
-                int cell_index = y * field_columns + x;
-                if (state_field[cell_index] != OPEN) continue;
-                if (field[cell_index] != 0) continue;
+    return a.x == x && a.y == y;
+}
 
-                /* Iterate through the neighboring cells and open it */
-                for (int sy = -1; sy <= 1; sy++) {
-                    for (int sx = -1; sx <= 1; sx++) {
-                        if (sx == 0 && sy == 0) continue;
-                        if (x + sx < 0 || x + sx >= field_columns) continue;
-                        if (y + sy < 0 || y + sy >= field_rows) continue;
-                        int neighbour_cell_index = (y + sy) * field_columns + (x + sx);
-                        if (state_field[neighbour_cell_index] != OPEN) {
-                            state_field[neighbour_cell_index] = OPEN;
-                            run = true;
-                            score++;
-                        }
-                    }
-                }
-            }
-        }
+
+/* Save the recording of the current board if anything was played on it.
+ * A game left before its end is saved with the board still playing */
+void save_recording(void)
+{
+    if (recording.event_count == 0) return;
+    recording_finish(&recording, board);
+#ifdef _WIN32
+    _mkdir(recording_dir);
+#else
+    mkdir(recording_dir, 0755);
+#endif
+    const char *file_path = TextFormat("%s/game-%lld-%016llx.msr", recording_dir,
+                                       (long long)time(NULL), (unsigned long long)recording.seed);
+    if (!recording_save(&recording, file_path)) {
+        TraceLog(LOG_WARNING, "Could not save recording to %s", file_path);
     }
+    recording.event_count = 0;
 }
 
+void start_recording(void)
+{
+    save_recording();
+    recording_start(&recording, board->seed, board->columns, board->rows, bomb_percent);
+    recording.is_no_guess = is_no_guess_field();
+}
 
-bool check_win(void)
+
+bool init_field(void)
 {
-    int cells = field_columns*field_rows;;
-    for (int i = 0; i < cells; i++) {
-        if (field[i] == -1) continue;
-        else if (state_field[i] != OPEN) return false;
+    save_recording();
+    double start = GetTime();
+    bool ok = board_init(board, field_columns, field_rows, bomb_percent, next_game_seed());
+    add_phase_time(PHASE_INIT_FIELD, start);
+    if (!ok) {
+        TraceLog(LOG_WARNING, "Could not allocate %dx%d field", field_columns, field_rows);
+        return false;
     }
+    start_recording();
+    reset_camera();
     return true;
 }
 
 
-void render_difficulty_menu(int screen_width, int screen_height)
+Texture2D load_cell_atlas(Image flag_icon, Image bomb_icon)
 {
-    /* Draw 8 x 8 button */
-    Rectangle easy_rect = draw_text_centered(
-        "8x8, 10 bombs",
-        menu_font,
-        MENU_BUTTON_FONT_SIZE,
-        TEXT_COLOR,
-        CLITERAL(Vector2){screen_width/2, screen_height/2 - 100}
-    );
+    Image atlas = GenImageColor(TILE_COUNT*ATLAS_TILE_STEP, ATLAS_TILE_STEP, BLANK);
+    for (int tile = 0; tile < TILE_COUNT; tile++) {
+        Color background = CELL_COLOR;
+        if (tile == TILE_CLOSED_HOVER || tile == TILE_FLAG_HOVER) background = CELL_COLOR_HOVER;
+        else if (tile == TILE_BOMB) background = BOMB_CELL_COLOR;
+        else if (tile == TILE_EMPTY) background = EMPTY_CELL_COLOR;
+        else if (tile == TILE_BACKGROUND) background = BACKGROUND_COLOR;
+        else if (tile >= TILE_DIGIT_1) background = OPEN_CELL_COLOR;
+
+        int tile_x = tile*ATLAS_TILE_STEP;
+        ImageDrawRectangle(&atlas, tile_x, 0, ATLAS_TILE_STEP, ATLAS_TILE_STEP, background);
+        int cell_x = tile_x + ATLAS_PADDING;
+        int cell_y = ATLAS_PADDING;
+
+        if (tile >= TILE_DIGIT_1) {
+            /* Count of bombs around */
+            const char *cell_text = TextFormat("%i", tile - TILE_DIGIT_1 + 1);
+            Vector2 cell_text_size = MeasureTextEx(field_font, cell_text, FIELD_FONT_SIZE, 1);
+            Vector2 cell_text_position = {
+                (cell_x + CELL_SIZE/2) - cell_text_size.x/2,
+                (cell_y + CELL_SIZE/2) - cell_text_size.y/2
+            };
+            ImageDrawTextEx(&atlas, field_font, cell_text, cell_text_position, FIELD_FONT_SIZE, 1, CELL_TEXT_COLOR);
+        } else if (tile == TILE_BOMB || tile == TILE_FLAG || tile == TILE_FLAG_HOVER) {
+            /* Icon with a 5 pixel margin */
+            Image icon = tile == TILE_BOMB ? bomb_icon : flag_icon;
+            float scale = ((float)CELL_SIZE - 10) / (float)icon.width;
+            ImageDraw(
+                &atlas,
+                icon,
+                CLITERAL(Rectangle){0, 0, icon.width, icon.height},
+                CLITERAL(Rectangle){cell_x + 5, cell_y + 5, icon.width*scale, icon.height*scale},
+                TEXT_COLOR
+            );
+        }
+    }
 
-    /* Draw 16 x 16 button */
-    Rectangle medium_rect = draw_text_centered(
-        "16x16, 40 bombs",
-        menu_font,
-        MENU_BUTTON_FONT_SIZE,
-        TEXT_COLOR,
-        CLITERAL(Vector2){screen_width/2, screen_height/2}
-    );
+    Texture2D texture = LoadTextureFromImage(atlas);
+    SetTextureFilter(texture, TEXTURE_FILTER_BILINEAR);
+    UnloadImage(atlas);
+    return texture;
+}
 
-    /* Draw 25 x 16 button */
-    Rectangle hard_rect = draw_text_centered(
-        "25x16, 63 bombs",
-        menu_font,
-        MENU_BUTTON_FONT_SIZE,
-        TEXT_COLOR,
-        CLITERAL(Vector2){screen_width/2, screen_height/2 + 100}
-    );
 
-    /* Check mouse click */
-    if (is_mouse_or_key_released(MOUSE_BUTTON_LEFT, KEY_Z)) {
-        Vector2 mouse_position = GetMousePosition();
-        if (CheckCollisionPointRec(mouse_position, easy_rect)) {
-            field_columns = 8;
-            field_rows = 8;
-            current_state = GAME;
-        } else if (CheckCollisionPointRec(mouse_position, medium_rect)) {
-            field_columns = 16;
-            field_rows = 16;
-            current_state = GAME;
-        } else if (CheckCollisionPointRec(mouse_position, hard_rect)) {
-            field_columns = 25;
-            field_rows = 16;
-            current_state = GAME;
-        }
+/* Add one cell to the current quad batch */
+void draw_cell_tile(atlas_tile tile, Rectangle rect)
+{
+    float u0 = (float)(tile*ATLAS_TILE_STEP + ATLAS_PADDING) / cell_atlas_texture.width;
+    float u1 = (float)(tile*ATLAS_TILE_STEP + ATLAS_PADDING + CELL_SIZE) / cell_atlas_texture.width;
+    float v0 = (float)ATLAS_PADDING / cell_atlas_texture.height;
+    float v1 = (float)(ATLAS_PADDING + CELL_SIZE) / cell_atlas_texture.height;
+
+    rlTexCoord2f(u0, v0);
+    rlVertex2f(rect.x, rect.y);
+    rlTexCoord2f(u0, v1);
+    rlVertex2f(rect.x, rect.y + rect.height);
+    rlTexCoord2f(u1, v1);
+    rlVertex2f(rect.x + rect.width, rect.y + rect.height);
+    rlTexCoord2f(u1, v0);
+    rlVertex2f(rect.x + rect.width, rect.y);
+}
 
-        if (current_state == GAME) {
-            score = 0;
-            seconds_played = 0;
-            init_field();
-            is_field_generated = true;
-        }
-    }
+
+atlas_tile pick_cell_tile(cell c, bool is_highlighted)
+{
+    cell_state state = cell_get_state(c);
+    /* The endless field can't open all of its bombs, show the visible ones */
+    if (is_endless && world.status == BOARD_LOST && cell_is_bomb(c)) state = OPEN;
+
+    if (state == OPEN && cell_is_bomb(c)) return TILE_BOMB;
+    if (state == OPEN && cell_bombs_around(c) == 0) return TILE_EMPTY;
+    if (state == OPEN) return TILE_DIGIT_1 + cell_bombs_around(c) - 1;
+    if (state == FLAG) return is_highlighted ? TILE_FLAG_HOVER : TILE_FLAG;
+    return is_highlighted ? TILE_CLOSED_HOVER : TILE_CLOSED;
 }
 
-void process_lose(void)
+
+/* Add the cell at (x, y) to the current quad batch. A pressed closed cell
+ * is drawn smaller, over the background */
+void draw_field_cell(int x, int y, bool is_highlighted, bool is_pressed)
 {
-    for (int i = 0; i < field_columns*field_rows; i++) {
-        if (field[i] == -1) state_field[i] = OPEN;
+    cell c = field_get_cell(x, y);
+    atlas_tile tile = pick_cell_tile(c, is_highlighted);
+    Rectangle cell_rect = {(float)x*CELL_STEP, (float)y*CELL_STEP, CELL_SIZE, CELL_SIZE};
+
+    if (is_pressed && tile != TILE_EMPTY && tile != TILE_BOMB && tile < TILE_DIGIT_1) {
+        draw_cell_tile(TILE_BACKGROUND, cell_rect);
+        float shrink = (CELL_SIZE - CELL_SIZE_PRESSED) / 2;
+        cell_rect = CLITERAL(Rectangle){
+            cell_rect.x + shrink,
+            cell_rect.y + shrink,
+            CELL_SIZE_PRESSED,
+            CELL_SIZE_PRESSED
+        };
     }
-    current_state = LOSE;
+    draw_cell_tile(tile, cell_rect);
 }
 
-// TODO: Simplify render_field()
-void render_field(Vector2 field_position, bool interactive)
+
+bool is_cell_visible(field_view view, int x, int y)
 {
-    for (int y = 0; y < field_rows; y++) {
-        for (int x = 0; x < field_columns; x++) {
-            int cell_index = y * field_columns + x;
-            int cell_size = CELL_SIZE;
-            int cell_x = field_position.x + x*CELL_SIZE + x*CELL_GAP;
-            int cell_y = field_position.y + y*CELL_SIZE + y*CELL_GAP;
+    return x >= view.first_x && x < view.first_x + view.columns &&
+           y >= view.first_y && y < view.first_y + view.rows;
+}
 
-            Rectangle cell_rect = {
-                .x = cell_x,
-                .y = cell_y,
-                .height = CELL_SIZE,
-                .width = CELL_SIZE
-            };
-            bool is_cell_hovered = CheckCollisionPointRec(GetMousePosition(), cell_rect);
-
-            /* Set cell color */
-            Color cell_color = CELL_COLOR;
-            if (state_field[cell_index] == OPEN && field[cell_index] == 0) cell_color = EMPTY_CELL_COLOR;
-            else if (state_field[cell_index] == OPEN && field[cell_index] == -1) cell_color = BOMB_CELL_COLOR;
-            else if (state_field[cell_index] == OPEN) cell_color = OPEN_CELL_COLOR;
-            else if (is_cell_hovered && interactive) cell_color = CELL_COLOR_HOVER;
-            /* Set cell size */
-            if (interactive &&
-                state_field[cell_index] != OPEN &&
-                is_cell_hovered &&
-                (is_mouse_or_key_down(MOUSE_BUTTON_LEFT, KEY_Z) &&
-                 cell_left_pressed_index == cell_index))
-            {
-                cell_size = CELL_SIZE_PRESSED;
+
+/* Bring the cached picture of the viewport up to date. Everything is
+ * redrawn only when the camera moved or the board was replaced, otherwise
+ * just the cells the board reports as changed and the cells whose
+ * highlight changed */
+void update_field_cache(field_view view, cell_position highlight, bool is_pressed)
+{
+    int width = view.viewport.width;
+    int height = view.viewport.height;
+    if (field_cache.texture.width != width || field_cache.texture.height != height) {
+        if (field_cache.id != 0) UnloadRenderTexture(field_cache);
+        field_cache = LoadRenderTexture(width, height);
+        is_field_cache_valid = false;
+    }
+    /* The worker is writing the cells, the picture of the closed field
+     * stays as it is until it is done */
+    if (is_generating) return;
+
+    /* Same camera, relative to the texture instead of the screen */
+    Camera2D cache_camera = camera;
+    cache_camera.offset.x -= view.viewport.x;
+    cache_camera.offset.y -= view.viewport.y;
+    if (cache_camera.target.x != field_cache_camera.target.x ||
+        cache_camera.target.y != field_cache_camera.target.y ||
+        cache_camera.offset.x != field_cache_camera.offset.x ||
+        cache_camera.offset.y != field_cache_camera.offset.y ||
+        cache_camera.zoom != field_cache_camera.zoom)
+    {
+        is_field_cache_valid = false;
+    }
+    if (!is_endless && board->is_all_changed) is_field_cache_valid = false;
+
+    bool is_highlight_changed = !is_same_cell(field_cache_highlight, highlight.x, highlight.y) ||
+                                is_field_cache_highlight_pressed != is_pressed;
+    bool has_changes = !is_endless && board->change_count > 0;
+    if (is_field_cache_valid && !is_highlight_changed && !has_changes) return;
+
+    BeginTextureMode(field_cache);
+    if (!is_field_cache_valid) ClearBackground(BACKGROUND_COLOR);
+    BeginMode2D(cache_camera);
+    rlSetTexture(cell_atlas_texture.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(255, 255, 255, 255);
+    rlNormal3f(0, 0, 1);
+
+    if (!is_field_cache_valid) {
+        for (int y = view.first_y; y < view.first_y + view.rows; y++) {
+            for (int x = view.first_x; x < view.first_x + view.columns; x++) {
+                bool is_highlighted = is_same_cell(highlight, x, y);
+                draw_field_cell(x, y, is_highlighted, is_highlighted && is_pressed);
             }
-            /* Draw cell */
-            int visible_cell_x = cell_x + (CELL_SIZE - cell_size) / 2;
-            int visible_cell_y = cell_y + (CELL_SIZE - cell_size) / 2;
-            DrawRectangle(visible_cell_x, visible_cell_y, cell_size, cell_size, cell_color);
-
-            /* If cell is open and its not flaged, draw the count of bombs around it */
-            if (state_field[cell_index] == OPEN && field[cell_index] > 0) {
-                const char *cell_text = TextFormat("%i", field[y*field_columns + x]);
-                Vector2 cell_text_size = MeasureTextEx(field_font, cell_text, FIELD_FONT_SIZE, 1);
-                Vector2 cell_text_position = {
-                    (cell_x + CELL_SIZE/2) - cell_text_size.x/2,
-                    (cell_y + CELL_SIZE/2) - cell_text_size.y/2
-                };
-                DrawTextEx(field_font, cell_text, cell_text_position, FIELD_FONT_SIZE, 1, CELL_TEXT_COLOR);
-            } else if (state_field[cell_index] == OPEN && field[cell_index] == -1) {
-                /* Draw bomb icon */
-                float scale = ((float)cell_size - 10) / (float)bomb_icon_image.width;
-                DrawTextureEx(
-                    bomb_icon_texture,
-                    CLITERAL(Vector2){visible_cell_x + 5, visible_cell_y + 5},
-                    0,
-                    scale,
-                    TEXT_COLOR
-                );
-            } else if (state_field[cell_index] == FLAG) {
-                /* Draw flag icon */
-                float scale = ((float)cell_size - 10) / (float)flag_icon_image.width;
-                DrawTextureEx(
-                    flag_icon_texture,
-                    CLITERAL(Vector2){visible_cell_x + 5, visible_cell_y + 5},
-                    0,
-                    scale,
-                    TEXT_COLOR
-                );
+        }
+    } else {
+        for (int i = 0; has_changes && i < board->change_count; i++) {
+            int x = board->changes[i] % board->columns;
+            int y = board->changes[i] / board->columns;
+            if (!is_cell_visible(view, x, y)) continue;
+            bool is_highlighted = is_same_cell(highlight, x, y);
+            draw_field_cell(x, y, is_highlighted, is_highlighted && is_pressed);
+        }
+        if (is_highlight_changed) {
+            cell_position old = field_cache_highlight;
+            if (is_cell_visible(view, old.x, old.y)) draw_field_cell(old.x, old.y, false, false);
+            if (is_cell_visible(view, highlight.x, highlight.y)) {
+                draw_field_cell(highlight.x, highlight.y, true, is_pressed);
             }
+        }
+    }
 
-            /* Process events */
-            if (!interactive) continue;
+    rlEnd();
+    rlSetTexture(0);
+    EndMode2D();
+    EndTextureMode();
 
-            /* Check if mouse was pressed on cell */
-            if (is_mouse_or_key_pressed(MOUSE_BUTTON_LEFT, KEY_Z) && is_cell_hovered) {
-                cell_left_pressed_index = cell_index;
-            } else if (is_mouse_or_key_pressed(MOUSE_BUTTON_RIGHT, KEY_X) && is_cell_hovered) {
-                cell_right_pressed_index = cell_index;
-            }
+    if (!is_endless) board_clear_changes(board);
+    field_cache_camera = cache_camera;
+    field_cache_highlight = highlight;
+    is_field_cache_highlight_pressed = is_pressed;
+    is_field_cache_valid = true;
+}
 
-            /* Check if mouse was unpressed and pressed on cell */
-            if (is_cell_hovered) {
-                if (state_field[cell_index] == CLOSE &&
-                    is_mouse_or_key_released(MOUSE_BUTTON_LEFT, KEY_Z) &&
-                    cell_left_pressed_index == cell_index)
-                {
-                    state_field[cell_index] = OPEN;
-                    PlaySound(open_cell_sound);
-                    if (field[cell_index] == 0) open_empty_cells();
-                    else if (field[cell_index] != -1) score++;
-
-                    if (field[cell_index] == -1) process_lose();
-                    else if (check_win()) current_state = WIN;
-                } else if (is_mouse_or_key_released(MOUSE_BUTTON_RIGHT, KEY_X) &&
-                           cell_right_pressed_index == cell_index &&
-                           state_field[cell_index] != OPEN)
-                {
-                    if (state_field[cell_index] == CLOSE &&
-                        flags() < bombs) {
-                      state_field[cell_index] = FLAG;
-                    }
-                    else {
-                      state_field[cell_index] = CLOSE;
-                    }
-                }
-            }
+
+/* The cell under the mouse, worked out from the camera instead of testing
+ * every cell. None over a gap, outside the viewport or outside a bounded
+ * field */
+cell_position find_hovered_cell(field_view view)
+{
+    cell_position none = {INT_MIN, INT_MIN};
+    Vector2 screen_position = GetMousePosition();
+    if (!CheckCollisionPointRec(screen_position, view.viewport)) return none;
+
+    Vector2 position = GetScreenToWorld2D(screen_position, camera);
+    float column = floorf(position.x / CELL_STEP);
+    float row = floorf(position.y / CELL_STEP);
+    if (position.x - column*CELL_STEP >= CELL_SIZE) return none;
+    if (position.y - row*CELL_STEP >= CELL_SIZE) return none;
+
+    cell_position hovered = {column, row};
+    if (!is_endless) {
+        if (hovered.x < 0 || hovered.x >= board->columns) return none;
+        if (hovered.y < 0 || hovered.y >= board->rows) return none;
+    }
+    return hovered;
+}
+
+
+void sample_field_input(field_view view)
+{
+    bool is_left_down = is_mouse_or_key_down(MOUSE_BUTTON_LEFT, KEY_Z);
+    bool is_right_down = is_mouse_or_key_down(MOUSE_BUTTON_RIGHT, KEY_X);
+    bool is_left_released = is_mouse_or_key_released(MOUSE_BUTTON_LEFT, KEY_Z);
+    bool is_right_released = is_mouse_or_key_released(MOUSE_BUTTON_RIGHT, KEY_X);
+    bool was_chording = is_chording || (is_left_down && is_right_down && !is_dragging_field);
+    is_chording = was_chording && (is_left_down || is_right_down);
+
+    cell_position hovered = find_hovered_cell(view);
+    if (hovered.x == INT_MIN) return;
+
+    /* Check if mouse was pressed on cell */
+    if (is_mouse_or_key_pressed(MOUSE_BUTTON_LEFT, KEY_Z)) {
+        cell_left_pressed = hovered;
+    } else if (is_mouse_or_key_pressed(MOUSE_BUTTON_RIGHT, KEY_X)) {
+        cell_right_pressed = hovered;
+    }
+    if (is_mouse_or_key_pressed(MOUSE_BUTTON_MIDDLE, KEY_C)) cell_middle_pressed = hovered;
+
+    /* The middle button, or the first of both buttons released, chords */
+    if (was_chording) {
+        bool is_first_release = (is_left_released && (is_right_down || is_right_released)) ||
+                                (is_right_released && is_left_down);
+        if (is_first_release) {
+            push_command(CLITERAL(Command){.type = COMMAND_CHORD, .x = hovered.x, .y = hovered.y});
         }
+    } else if (is_mouse_or_key_released(MOUSE_BUTTON_MIDDLE, KEY_C) &&
+               is_same_cell(cell_middle_pressed, hovered.x, hovered.y))
+    {
+        push_command(CLITERAL(Command){.type = COMMAND_CHORD, .x = hovered.x, .y = hovered.y});
+    } else if (is_left_released &&
+               !is_dragging_field &&
+               is_same_cell(cell_left_pressed, hovered.x, hovered.y))
+    {
+        push_command(CLITERAL(Command){.type = COMMAND_REVEAL, .x = hovered.x, .y = hovered.y});
+    } else if (is_right_released &&
+               is_same_cell(cell_right_pressed, hovered.x, hovered.y))
+    {
+        push_command(CLITERAL(Command){.type = COMMAND_TOGGLE_FLAG, .x = hovered.x, .y = hovered.y});
     }
 }
 
 
+void render_field(field_view view, bool interactive)
+{
+    double start = GetTime();
+    cell_position hovered = find_hovered_cell(view);
+
+    /* A closed cell shrinks while the left button is held on it */
+    cell_position highlight = {INT_MIN, INT_MIN};
+    if (interactive) highlight = hovered;
+    bool is_pressed = interactive &&
+                      hovered.x != INT_MIN &&
+                      !is_dragging_field &&
+                      !is_chording &&
+                      is_mouse_or_key_down(MOUSE_BUTTON_LEFT, KEY_Z) &&
+                      is_same_cell(cell_left_pressed, hovered.x, hovered.y);
+    update_field_cache(view, highlight, is_pressed);
+
+    /* Render textures are stored upside down */
+    DrawTextureRec(
+        field_cache.texture,
+        CLITERAL(Rectangle){0, 0, field_cache.texture.width, -field_cache.texture.height},
+        CLITERAL(Vector2){view.viewport.x, view.viewport.y},
+        WHITE
+    );
+    add_phase_time(PHASE_RENDER_FIELD, start);
+}
+
+
 Vector2 render_flags(Vector2 position)
 {
     /* Calculate flags text size */
-    const char *flags_text = TextFormat("%d/%d", flags(), bombs);
+    const char *flags_text = is_endless
+        ? TextFormat("%d", world.flags)
+        : TextFormat("%d/%d", board_flags(board), board->bombs);
     Vector2 flags_text_size = MeasureTextEx(field_font, flags_text, 60, 1);
 
     /* Draw flag texture */
-    float scale = ((float)flags_text_size.y - 10) / (float)flag_icon_image.height;
+    float scale = ((float)flags_text_size.y - 10) / (float)flag_icon_texture.height;
     DrawTextureEx(
         flag_icon_texture,
         CLITERAL(Vector2) {position.x, position.y + 5},
@@ -475,7 +1023,7 @@ Vector2 render_flags(Vector2 position)
 
     /* Draw flags count */
     Vector2 flags_text_position = {
-        position.x + 10 + flag_icon_image.width * scale,
+        position.x + 10 + flag_icon_texture.width * scale,
         position.y
     };
     DrawTextEx(field_font, flags_text, flags_text_position, 60, 1, CELL_TEXT_COLOR);
@@ -489,7 +1037,7 @@ Vector2 render_clock(int seconds, Vector2 position)
     Vector2 time_text_size = MeasureTextEx(field_font, time_text, 60, 1);
 
     /* Draw flag texture */
-    float scale = ((float)time_text_size.y - 10) / (float)clock_icon_image.height;
+    float scale = ((float)time_text_size.y - 10) / (float)clock_icon_texture.height;
     DrawTextureEx(
         clock_icon_texture,
         CLITERAL(Vector2) {position.x, position.y + 5},
@@ -500,7 +1048,7 @@ Vector2 render_clock(int seconds, Vector2 position)
 
     /* Draw flags count */
     Vector2 time_text_position = {
-        position.x + 10 + clock_icon_image.width * scale,
+        position.x + 10 + clock_icon_texture.width * scale,
         position.y
     };
 
@@ -509,142 +1057,636 @@ Vector2 render_clock(int seconds, Vector2 position)
 }
 
 
-void render_game(int screen_width, int screen_height)
+/* Flags and clock, to the right of the field */
+void render_info_bar(field_view view)
 {
-    int field_width = field_columns*CELL_SIZE + ((field_columns - 1) * CELL_GAP);
-    int field_height = field_rows*CELL_SIZE + ((field_rows - 1) * CELL_GAP);
-
-    int field_start_x = screen_width/2 - field_width/2 - 200;
-    int field_start_y = screen_height/2 - field_height/2;
+    double start = GetTime();
+    float x = view.bounds.x + view.bounds.width + INFO_BAR_GAP;
+    float y = view.bounds.y;
 
     /* Render score */
-    Vector2 flags_size = render_flags(
-        CLITERAL(Vector2){field_start_x + field_width + INFO_BAR_GAP, field_start_y}
-    );
+    Vector2 flags_size = render_flags(CLITERAL(Vector2){x, y});
 
     /* Render time */
-    seconds_played += GetFrameTime();
-    render_clock(
-        seconds_played,
-        CLITERAL(Vector2){field_start_x + field_width + INFO_BAR_GAP, field_start_y + 10 + flags_size.y}
+    render_clock(seconds_played, CLITERAL(Vector2){x, y + 10 + flags_size.y});
+    add_phase_time(PHASE_HUD, start);
+}
+
+
+field_view layout_field(int screen_width, int screen_height)
+{
+    field_view view = {0};
+    view.viewport = field_viewport(screen_width, screen_height);
+    camera.offset = CLITERAL(Vector2){
+        view.viewport.x + view.viewport.width/2,
+        view.viewport.y + view.viewport.height/2
+    };
+
+    /* Cells under the corners of the viewport */
+    Vector2 top_left = GetScreenToWorld2D(
+        CLITERAL(Vector2){view.viewport.x, view.viewport.y},
+        camera
+    );
+    Vector2 bottom_right = GetScreenToWorld2D(
+        CLITERAL(Vector2){view.viewport.x + view.viewport.width, view.viewport.y + view.viewport.height},
+        camera
     );
+    int first_x = floorf(top_left.x / CELL_STEP);
+    int first_y = floorf(top_left.y / CELL_STEP);
+    int last_x = floorf(bottom_right.x / CELL_STEP);
+    int last_y = floorf(bottom_right.y / CELL_STEP);
+
+    view.bounds = view.viewport;
+    if (!is_endless) {
+        if (first_x < 0) first_x = 0;
+        if (first_y < 0) first_y = 0;
+        if (last_x > board->columns - 1) last_x = board->columns - 1;
+        if (last_y > board->rows - 1) last_y = board->rows - 1;
+
+        /* Shrink the bounds to the field when it does not fill the viewport */
+        Vector2 field_top_left = GetWorldToScreen2D(CLITERAL(Vector2){0, 0}, camera);
+        Vector2 field_bottom_right = GetWorldToScreen2D(
+            CLITERAL(Vector2){board->columns*CELL_STEP - CELL_GAP, board->rows*CELL_STEP - CELL_GAP},
+            camera
+        );
+        float left = fmaxf(view.bounds.x, field_top_left.x);
+        float top = fmaxf(view.bounds.y, field_top_left.y);
+        float right = fminf(view.bounds.x + view.bounds.width, field_bottom_right.x);
+        float bottom = fminf(view.bounds.y + view.bounds.height, field_bottom_right.y);
+        view.bounds = CLITERAL(Rectangle){left, top, right - left, bottom - top};
+    }
+
+    view.first_x = first_x;
+    view.first_y = first_y;
+    view.columns = last_x - first_x + 1;
+    view.rows = last_y - first_y + 1;
+    return view;
+}
+
+
+/* Drag to pan, wheel to zoom around the mouse, arrows to move by a cell */
+void update_camera(int screen_width, int screen_height)
+{
+    Rectangle viewport = field_viewport(screen_width, screen_height);
+    Vector2 mouse_position = GetMousePosition();
+
+    if (is_mouse_or_key_pressed(MOUSE_BUTTON_LEFT, KEY_Z)) {
+        drag_start_position = mouse_position;
+        is_dragging_field = false;
+    }
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(drag_start_position, viewport)) {
+        float dx = mouse_position.x - drag_start_position.x;
+        float dy = mouse_position.y - drag_start_position.y;
+        if (dx*dx + dy*dy > DRAG_THRESHOLD*DRAG_THRESHOLD) is_dragging_field = true;
+        if (is_dragging_field) {
+            Vector2 delta = GetMouseDelta();
+            camera.target.x -= delta.x / camera.zoom;
+            camera.target.y -= delta.y / camera.zoom;
+        }
+    }
+
+    float wheel = GetMouseWheelMove();
+    if (wheel != 0 && CheckCollisionPointRec(mouse_position, viewport)) {
+        Vector2 before = GetScreenToWorld2D(mouse_position, camera);
+        camera.zoom = fmaxf(fminf(camera.zoom*powf(ZOOM_STEP, wheel), MAX_ZOOM), MIN_ZOOM);
+        Vector2 after = GetScreenToWorld2D(mouse_position, camera);
+        camera.target.x += before.x - after.x;
+        camera.target.y += before.y - after.y;
+    }
+
+    if (IsKeyPressed(KEY_LEFT) || IsKeyPressedRepeat(KEY_LEFT)) camera.target.x -= CELL_STEP;
+    if (IsKeyPressed(KEY_RIGHT) || IsKeyPressedRepeat(KEY_RIGHT)) camera.target.x += CELL_STEP;
+    if (IsKeyPressed(KEY_UP) || IsKeyPressedRepeat(KEY_UP)) camera.target.y -= CELL_STEP;
+    if (IsKeyPressed(KEY_DOWN) || IsKeyPressedRepeat(KEY_DOWN)) camera.target.y += CELL_STEP;
+
+    /* Keep the middle of the viewport over a bounded field */
+    if (!is_endless) {
+        camera.target.x = fmaxf(fminf(camera.target.x, board->columns*CELL_STEP - CELL_GAP), 0);
+        camera.target.y = fmaxf(fminf(camera.target.y, board->rows*CELL_STEP - CELL_GAP), 0);
+    }
+}
+
+
+void render_game(int screen_width, int screen_height)
+{
+    field_view view = layout_field(screen_width, screen_height);
+
+    render_info_bar(view);
 
     /* Render field */
-    render_field(
-        CLITERAL(Vector2){field_start_x, field_start_y},
-        true
-    );
+    render_field(view, true);
 }
 
 
-void render_end_game_screen(int screen_width, int screen_height)
+/* The field is frozen and drawn from its cache, the clock stops */
+void render_pause_screen(int screen_width, int screen_height)
 {
-    int field_width = field_columns*CELL_SIZE + ((field_columns - 1) * CELL_GAP);
-    int field_height = field_rows*CELL_SIZE + ((field_rows - 1) * CELL_GAP);
+    field_view view = layout_field(screen_width, screen_height);
+
+    /* Render field */
+    render_field(view, false);
+    DrawRectangleRec(view.bounds, Fade(BACKGROUND_COLOR, 0.6f));
+
+    render_info_bar(view);
+
+    Vector2 center = {
+        view.viewport.x + view.viewport.width/2,
+        view.viewport.y + view.viewport.height/2
+    };
+    draw_text_centered("Paused", logo_font, LOGO_FONT_SIZE, TEXT_COLOR, center);
+}
 
-    int field_start_x = screen_width/2 - field_width/2 - 200;
-    int field_start_y = screen_height/2 - field_height/2;
+
+void render_end_game_screen(int screen_width, int screen_height)
+{
+    field_view view = layout_field(screen_width, screen_height);
 
     /* Render field */
-    render_field(
-        CLITERAL(Vector2){field_start_x, field_start_y},
-        false
-    );
+    render_field(view, false);
 
-    /* Render score */
-    Vector2 flags_size = render_flags(
-        CLITERAL(Vector2){field_start_x + field_width + INFO_BAR_GAP, field_start_y}
-    );
+    render_info_bar(view);
+}
 
-    /* Render time */
-    render_clock(
-        seconds_played,
-        CLITERAL(Vector2){field_start_x + field_width + INFO_BAR_GAP, field_start_y + 10 + flags_size.y}
-    );
 
-    /* Render buttons */
-    Rectangle play_again_rect = draw_text(
-        "Play again",
-        end_game_button_font,
-        END_GAME_BUTTON_FONT_SIZE,
-        TEXT_COLOR,
-        CLITERAL(Vector2){field_start_x + field_width + 25, field_start_y + field_height - 150}
-    );
+/* Buttons of the current screen */
+int layout_buttons(int screen_width, int screen_height, Button *buttons)
+{
+    int count = 0;
+    Vector2 center = {screen_width/2, screen_height/2};
+    switch (current_state) {
+    case MENU:
+        buttons[count++] = make_button_centered("Play", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                center, ACTION_PLAY);
+        buttons[count++] = make_button_centered("Exit", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                CLITERAL(Vector2){center.x, center.y + 100}, ACTION_EXIT);
+        break;
+    case CHOOSE_DIFFICULTY:
+        buttons[count++] = make_button_centered(TextFormat("No guessing: %s", is_no_guess ? "on" : "off"),
+                                                menu_font, MENU_BUTTON_FONT_SIZE,
+                                                is_no_guess ? WIN_TEXT_COLOR : TEXT_COLOR,
+                                                CLITERAL(Vector2){center.x, center.y - 200}, ACTION_TOGGLE_NO_GUESS);
+        buttons[count++] = make_button_centered("8x8, 10 bombs", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                CLITERAL(Vector2){center.x, center.y - 100}, ACTION_EASY);
+        buttons[count++] = make_button_centered("16x16, 40 bombs", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                center, ACTION_MEDIUM);
+        buttons[count++] = make_button_centered("25x16, 63 bombs", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                CLITERAL(Vector2){center.x, center.y + 100}, ACTION_HARD);
+        buttons[count++] = make_button_centered("Custom", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                CLITERAL(Vector2){center.x, center.y + 200}, ACTION_CUSTOM);
+        buttons[count++] = make_button_centered("Endless", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                CLITERAL(Vector2){center.x, center.y + 300}, ACTION_ENDLESS);
+        break;
+    case CHOOSE_CUSTOM_SIZE: {
+        /* Greyed out and off for boards too big to generate without
+         * guessing */
+        bool is_no_guess_allowed = is_no_guess_size(custom_columns, custom_rows);
+        const char *no_guess_text = !is_no_guess_allowed
+            ? TextFormat("No guessing: off above %d cells", NO_GUESS_MAX_CELLS)
+            : TextFormat("No guessing: %s", is_no_guess ? "on" : "off");
+        Color no_guess_color = !is_no_guess_allowed ? Fade(TEXT_COLOR, 0.4f)
+                             : is_no_guess ? WIN_TEXT_COLOR : TEXT_COLOR;
+        buttons[count++] = make_button_centered(no_guess_text, menu_font, MENU_BUTTON_FONT_SIZE, no_guess_color,
+                                                CLITERAL(Vector2){center.x, center.y - 300}, ACTION_TOGGLE_NO_GUESS);
+        buttons[count++] = make_button_centered(
+            TextFormat("Columns: %d", custom_columns),
+            menu_font,
+            MENU_BUTTON_FONT_SIZE,
+            custom_selected_size == &custom_columns ? WIN_TEXT_COLOR : TEXT_COLOR,
+            CLITERAL(Vector2){center.x, center.y - 200},
+            ACTION_SELECT_COLUMNS
+        );
+        buttons[count++] = make_button_centered(
+            TextFormat("Rows: %d", custom_rows),
+            menu_font,
+            MENU_BUTTON_FONT_SIZE,
+            custom_selected_size == &custom_rows ? WIN_TEXT_COLOR : TEXT_COLOR,
+            CLITERAL(Vector2){center.x, center.y - 100},
+            ACTION_SELECT_ROWS
+        );
+        buttons[count++] = make_button_centered(
+            TextFormat("Bombs: %d%%", custom_bomb_percent),
+            menu_font,
+            MENU_BUTTON_FONT_SIZE,
+            custom_selected_size == &custom_bomb_percent ? WIN_TEXT_COLOR : TEXT_COLOR,
+            center,
+            ACTION_SELECT_BOMB_PERCENT
+        );
+        buttons[count++] = make_button_centered("Play", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                CLITERAL(Vector2){center.x, center.y + 100}, ACTION_START_CUSTOM);
+        buttons[count++] = make_button_centered("Back", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                CLITERAL(Vector2){center.x, center.y + 200}, ACTION_BACK);
+    } break;
+    case PAUSE: {
+        field_view view = layout_field(screen_width, screen_height);
+        Vector2 field_center = {
+            view.viewport.x + view.viewport.width/2,
+            view.viewport.y + view.viewport.height/2
+        };
+        buttons[count++] = make_button_centered("Continue", menu_font, MENU_BUTTON_FONT_SIZE, TEXT_COLOR,
+                                                CLITERAL(Vector2){field_center.x, field_center.y + 100},
+                                                ACTION_CONTINUE);
+    } break;
+    case WIN:
+    case LOSE: {
+        field_view view = layout_field(screen_width, screen_height);
+        float x = view.bounds.x + view.bounds.width + 25;
+        float y = view.bounds.y + view.bounds.height - 150;
+        const struct {
+            const char *text;
+            menu_action action;
+        } end_game_buttons[] = {
+            {"Play again", ACTION_PLAY_AGAIN},
+            {"Change difficulty", ACTION_CHANGE_DIFFICULTY},
+            {"Exit", ACTION_EXIT},
+        };
+        for (size_t i = 0; i < sizeof(end_game_buttons)/sizeof(end_game_buttons[0]); i++) {
+            buttons[count] = make_button(end_game_buttons[i].text, end_game_button_font, END_GAME_BUTTON_FONT_SIZE,
+                                         TEXT_COLOR, CLITERAL(Vector2){x, y}, end_game_buttons[i].action);
+            y += buttons[count].rect.height + 10;
+            count++;
+        }
+    } break;
+    default:
+        break;
+    }
+    return count;
+}
 
-    Rectangle difficulty_rect = draw_text(
-        "Change difficulty",
-        end_game_button_font,
-        END_GAME_BUTTON_FONT_SIZE,
-        TEXT_COLOR,
-        CLITERAL(Vector2){field_start_x + field_width + 25, play_again_rect.y + play_again_rect.height + 10}
-    );
 
-    Rectangle exit_rect = draw_text(
-        "Exit",
-        end_game_button_font,
-        END_GAME_BUTTON_FONT_SIZE,
-        TEXT_COLOR,
-        CLITERAL(Vector2){field_start_x + field_width + 25, difficulty_rect.y + difficulty_rect.height + 10}
-    );
+void render_buttons(int screen_width, int screen_height)
+{
+    Button buttons[MAX_BUTTONS];
+    int count = layout_buttons(screen_width, screen_height, buttons);
+    for (int i = 0; i < count; i++) {
+        Button *button = &buttons[i];
+        DrawTextEx(button->font, button->text, CLITERAL(Vector2){button->rect.x, button->rect.y},
+                   button->font_size, 1, button->color);
+    }
+}
 
+
+/* Turn this frame's input into commands. Only the camera and the pressed
+ * cells are updated here, the game itself is left to step_game() */
+void sample_input(int screen_width, int screen_height)
+{
+    Button buttons[MAX_BUTTONS];
+    int button_count = layout_buttons(screen_width, screen_height, buttons);
     if (is_mouse_or_key_released(MOUSE_BUTTON_LEFT, KEY_Z)) {
-        Vector2 mouse = GetMousePosition();
-        if (CheckCollisionPointRec(mouse, play_again_rect)) {
-            score = 0;
-            seconds_played = 0;
+        Vector2 mouse_position = GetMousePosition();
+        for (int i = 0; i < button_count; i++) {
+            if (CheckCollisionPointRec(mouse_position, buttons[i].rect)) {
+                push_command(CLITERAL(Command){.type = COMMAND_MENU_ACTION, .value = buttons[i].action});
+                break;
+            }
+        }
+    }
+
+    switch (current_state) {
+    case CHOOSE_CUSTOM_SIZE: {
+        int key = GetCharPressed();
+        while (key > 0) {
+            if (key >= '0' && key <= '9') {
+                push_command(CLITERAL(Command){.type = COMMAND_TYPE_DIGIT, .value = key - '0'});
+            }
+            key = GetCharPressed();
+        }
+        if (IsKeyPressed(KEY_BACKSPACE)) push_command(CLITERAL(Command){.type = COMMAND_ERASE_DIGIT});
+        if (IsKeyPressed(KEY_TAB)) {
+            push_command(CLITERAL(Command){.type = COMMAND_MENU_ACTION, .value = ACTION_NEXT_SIZE_FIELD});
+        }
+        if (IsKeyPressed(KEY_ENTER)) {
+            push_command(CLITERAL(Command){.type = COMMAND_MENU_ACTION, .value = ACTION_START_CUSTOM});
+        }
+    } break;
+    case GAME:
+        update_camera(screen_width, screen_height);
+        sample_field_input(layout_field(screen_width, screen_height));
+        /* A running game also stops when the window is left */
+        if (IsKeyPressed(KEY_P) || !IsWindowFocused() || IsWindowMinimized()) {
+            push_command(CLITERAL(Command){.type = COMMAND_MENU_ACTION, .value = ACTION_PAUSE});
+        }
+        break;
+    case PAUSE:
+        if (IsKeyPressed(KEY_P)) {
+            push_command(CLITERAL(Command){.type = COMMAND_MENU_ACTION, .value = ACTION_CONTINUE});
+        }
+        break;
+    case WIN:
+    case LOSE:
+        update_camera(screen_width, screen_height);
+        break;
+    default:
+        break;
+    }
+}
+
+
+/* End the game after a move that won or lost it */
+void update_game_status(void)
+{
+    if (field_status() == BOARD_LOST) current_state = LOSE;
+    else if (field_status() == BOARD_WON) current_state = WIN;
+    if (current_state != GAME && !is_endless) {
+        save_recording();
+        start_next_board();
+    }
+    /* The endless world does not track its changes */
+    if (is_endless) is_field_cache_valid = false;
+}
+
+
+void reveal_cell(int x, int y)
+{
+    bool is_inside = !is_endless && x >= 0 && x < board->columns && y >= 0 && y < board->rows;
+    if (is_inside && !board->is_field_generated && !is_no_guess_field() &&
+        board->columns*board->rows >= SLOW_GENERATION_MIN_CELLS &&
+        cell_get_state(board->cells[y*board->columns + x]) == CLOSE &&
+        start_field_generation(x, y)) {
+        return;
+    }
+
+    bool is_first_click = !is_field_started();
+    double reveal_start = GetTime();
+    int opened = field_reveal(x, y);
+    double reveal_time = GetTime() - reveal_start;
+    add_phase_time(PHASE_REVEAL, reveal_start);
+    if (opened > 0) PlaySound(open_cell_sound);
+    if (is_first_click && reveal_time > 1.0/FPS) {
+        TraceLog(LOG_WARNING, "First click on %dx%d field took %.1f ms, more than a frame",
+                 board->columns, board->rows, reveal_time*1000);
+    }
+
+    update_game_status();
+}
+
+
+void chord_cell(int x, int y)
+{
+    double chord_start = GetTime();
+    int opened = field_chord(x, y);
+    add_phase_time(PHASE_REVEAL, chord_start);
+    if (opened > 0) PlaySound(open_cell_sound);
+    update_game_status();
+}
+
+
+void record_event(replay_event_type type, int x, int y)
+{
+    if (!recording_add_event(&recording, type, seconds_played*1000, x, y)) {
+        TraceLog(LOG_WARNING, "Could not record the game, out of memory");
+    }
+}
+
+
+void start_preset_game(int columns, int rows)
+{
+    field_columns = columns;
+    field_rows = rows;
+    bomb_percent = DEFAULT_BOMB_PERCENT;
+    is_endless = false;
+    seconds_played = 0;
+    if (init_field()) current_state = GAME;
+}
+
+
+void apply_menu_action(menu_action action)
+{
+    /* Anything but a pause leaves the board, which has to be complete */
+    if (action != ACTION_PAUSE && action != ACTION_CONTINUE) finish_field_generation();
+    switch (action) {
+    case ACTION_PLAY:
+        current_state = CHOOSE_DIFFICULTY; break;
+    case ACTION_EXIT:
+        finish_next_board();
+        current_state = QUIT;
+        break;
+    case ACTION_EASY:
+        start_preset_game(8, 8); break;
+    case ACTION_MEDIUM:
+        start_preset_game(16, 16); break;
+    case ACTION_HARD:
+        start_preset_game(25, 16); break;
+    case ACTION_CUSTOM:
+        current_state = CHOOSE_CUSTOM_SIZE; break;
+    case ACTION_TOGGLE_NO_GUESS:
+        if (current_state == CHOOSE_CUSTOM_SIZE && !is_no_guess_size(custom_columns, custom_rows)) break;
+        is_no_guess = !is_no_guess;
+        break;
+    case ACTION_ENDLESS:
+        seconds_played = 0;
+        is_endless = true;
+        if (init_endless_field()) current_state = GAME;
+        break;
+    case ACTION_SELECT_COLUMNS:
+        custom_selected_size = &custom_columns; break;
+    case ACTION_SELECT_ROWS:
+        custom_selected_size = &custom_rows; break;
+    case ACTION_SELECT_BOMB_PERCENT:
+        custom_selected_size = &custom_bomb_percent; break;
+    case ACTION_NEXT_SIZE_FIELD:
+        if (custom_selected_size == &custom_columns) custom_selected_size = &custom_rows;
+        else if (custom_selected_size == &custom_rows) custom_selected_size = &custom_bomb_percent;
+        else custom_selected_size = &custom_columns;
+        break;
+    case ACTION_START_CUSTOM:
+        if (custom_columns < MIN_CUSTOM_FIELD_SIZE) custom_columns = MIN_CUSTOM_FIELD_SIZE;
+        if (custom_columns > MAX_FIELD_COLUMNS) custom_columns = MAX_FIELD_COLUMNS;
+        if (custom_rows < MIN_CUSTOM_FIELD_SIZE) custom_rows = MIN_CUSTOM_FIELD_SIZE;
+        if (custom_rows > MAX_FIELD_ROWS) custom_rows = MAX_FIELD_ROWS;
+        if (custom_bomb_percent > MAX_BOMB_PERCENT) custom_bomb_percent = MAX_BOMB_PERCENT;
+
+        field_columns = custom_columns;
+        field_rows = custom_rows;
+        bomb_percent = custom_bomb_percent;
+        is_endless = false;
+        seconds_played = 0;
+        if (init_field()) current_state = GAME;
+        break;
+    case ACTION_BACK:
+        current_state = CHOOSE_DIFFICULTY; break;
+    case ACTION_PLAY_AGAIN:
+        seconds_played = 0;
+        if (is_endless) {
+            init_endless_field();
+        } else if (finish_next_board()) {
+            save_recording();
+            Board *played_board = board;
+            board = spare_board;
+            spare_board = played_board;
+            start_recording();
+            reset_camera();
+        } else {
             init_field();
-            is_field_generated = true;
-            current_state = GAME;
-        } else if (CheckCollisionPointRec(mouse, difficulty_rect)) {
-            current_state = CHOOSE_DIFFICULTY;
-        } else if (CheckCollisionPointRec(mouse, exit_rect)) {
-            current_state = QUIT;
         }
+        current_state = GAME;
+        break;
+    case ACTION_CHANGE_DIFFICULTY:
+        finish_next_board();
+        current_state = CHOOSE_DIFFICULTY;
+        break;
+    case ACTION_PAUSE:
+        if (current_state == GAME) current_state = PAUSE;
+        break;
+    case ACTION_CONTINUE:
+        if (current_state == PAUSE) current_state = GAME;
+        break;
     }
 }
 
 
-int main(void)
+/* Apply the queued commands in order and advance the clock */
+void step_game(void)
 {
-    SetTraceLogLevel(LOG_WARNING);
-    SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_VSYNC_HINT);
-    InitWindow(DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT, "Minesweeper");
-    InitAudioDevice();
-    SetTargetFPS(30);
-    srand(time(NULL));
+    if (is_generating && current_state == GAME && is_field_generation_done()) {
+        pthread_join(generation_thread, NULL);
+        is_generating = false;
+        reveal_cell(generation.safe_x, generation.safe_y);
+    }
+
+    for (int i = 0; i < command_count; i++) {
+        Command command = command_queue[i];
+        switch (command.type) {
+        case COMMAND_REVEAL:
+            if (current_state != GAME || is_generating) break;
+            if (!is_endless) record_event(EVENT_REVEAL, command.x, command.y);
+            reveal_cell(command.x, command.y);
+            break;
+        case COMMAND_CHORD:
+            if (current_state != GAME || is_generating) break;
+            if (!is_endless) record_event(EVENT_CHORD, command.x, command.y);
+            chord_cell(command.x, command.y);
+            break;
+        case COMMAND_TOGGLE_FLAG:
+            if (current_state != GAME || is_generating) break;
+            if (!is_endless) record_event(EVENT_TOGGLE_FLAG, command.x, command.y);
+            field_toggle_flag(command.x, command.y);
+            if (is_endless) is_field_cache_valid = false;
+            break;
+        case COMMAND_MENU_ACTION:
+            apply_menu_action(command.value);
+            break;
+        case COMMAND_TYPE_DIGIT:
+            if (*custom_selected_size <= MAX_FIELD_COLUMNS / 10) {
+                *custom_selected_size = *custom_selected_size*10 + command.value;
+            }
+            break;
+        case COMMAND_ERASE_DIGIT:
+            *custom_selected_size /= 10;
+            break;
+        }
+    }
+    command_count = 0;
+
+    /* The clock starts with the first click */
+    double now = GetTime();
+    if (current_state == GAME && is_clock_ticking) seconds_played += now - clock_tick_time;
+    clock_tick_time = now;
+    is_clock_ticking = current_state == GAME && is_field_started();
+}
 
-    logo_font            = LoadFontEx(FONT_FILEPATH, LOGO_FONT_SIZE, NULL, 0);
-    menu_font            = LoadFontEx(FONT_FILEPATH, MENU_BUTTON_FONT_SIZE, NULL, 0);
-    field_font           = LoadFontEx(FONT_FILEPATH, FIELD_FONT_SIZE, NULL, 0);
-    end_game_button_font = LoadFontEx(FONT_FILEPATH, END_GAME_BUTTON_FONT_SIZE, NULL, 0);
 
-    open_cell_sound = LoadSound(OPEN_CELL_SOUND_FILEPATH);
+/* Replay a recording without a window, `count` times over so it can
+ * serve as a profiling workload. Returns the process exit code */
+int replay_headless(const char *file_path, int count)
+{
+    Recording loaded = {0};
+    if (!recording_load(&loaded, file_path)) {
+        fprintf(stderr, "Could not read recording %s\n", file_path);
+        recording_free(&loaded);
+        return 1;
+    }
 
-    flag_icon_image   = LoadImage(FLAG_ICON_FILEPATH);
-    flag_icon_texture = LoadTextureFromImage(flag_icon_image);
+    Board replay_board = {0};
+    bool ok = true;
+    clock_t start = clock();
+    for (int i = 0; i < count && ok; i++) ok = recording_replay(&loaded, &replay_board);
+    double seconds = (double)(clock() - start)/CLOCKS_PER_SEC;
+
+    printf("%s: %dx%d, %d events, %d replays in %.3f ms (%.3f ms each): %s\n",
+           file_path, loaded.columns, loaded.rows, loaded.event_count, count,
+           seconds*1000, seconds*1000/count, ok ? "OK" : "MISMATCH");
+    board_free(&replay_board);
+    recording_free(&loaded);
+    return ok ? 0 : 1;
+}
 
-    clock_icon_image   = LoadImage(CLOCK_ICON_FILEPATH);
-    clock_icon_texture = LoadTextureFromImage(clock_icon_image);
 
-    bomb_icon_image   = LoadImage(BOMB_ICON_FILEPATH);
-    bomb_icon_texture = LoadTextureFromImage(bomb_icon_image);
+int main(int argc, char **argv)
+{
+    /* Raw frame timing samples are written here on exit */
+    const char *timing_csv_path = NULL;
+    const char *replay_path = NULL;
+    int replay_count = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--timing-csv") == 0 && i + 1 < argc) {
+            timing_csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--record-dir") == 0 && i + 1 < argc) {
+            recording_dir = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay-count") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            replay_count = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--timing-csv <file>] [--record-dir <dir>]\n"
+                            "       %s --replay <file> [--replay-count <n>]\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (replay_path != NULL) return replay_headless(replay_path, replay_count);
+
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_VSYNC_HINT);
+    InitWindow(DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT, "Minesweeper");
+    InitAudioDevice();
+    SetTargetFPS(FPS);
+    seed_state = time(NULL);
+    no_guess_threads = no_guess_default_threads();
+
+    /* Assets are embedded in the binary, nothing is read from disk */
+    int font_size = sizeof(open_sans_regular_ttf);
+    logo_font            = LoadFontFromMemory(".ttf", open_sans_regular_ttf, font_size, LOGO_FONT_SIZE, NULL, 0);
+    menu_font            = LoadFontFromMemory(".ttf", open_sans_regular_ttf, font_size, MENU_BUTTON_FONT_SIZE, NULL, 0);
+    field_font           = LoadFontFromMemory(".ttf", open_sans_regular_ttf, font_size, FIELD_FONT_SIZE, NULL, 0);
+    end_game_button_font = LoadFontFromMemory(".ttf", open_sans_regular_ttf, font_size, END_GAME_BUTTON_FONT_SIZE, NULL, 0);
+
+    Wave open_cell_wave = LoadWaveFromMemory(".wav", open_cell_wav, sizeof(open_cell_wav));
+    open_cell_sound = LoadSoundFromWave(open_cell_wave);
+    UnloadWave(open_cell_wave);
+
+    Image flag_icon = LoadImageFromMemory(".png", flag_png, sizeof(flag_png));
+    Image clock_icon = LoadImageFromMemory(".png", clock_png, sizeof(clock_png));
+    Image bomb_icon = LoadImageFromMemory(".png", bomb_png, sizeof(bomb_png));
+    flag_icon_texture = LoadTextureFromImage(flag_icon);
+    clock_icon_texture = LoadTextureFromImage(clock_icon);
+    cell_atlas_texture = load_cell_atlas(flag_icon, bomb_icon);
+    UnloadImage(bomb_icon);
+    UnloadImage(clock_icon);
+    UnloadImage(flag_icon);
 
     bool exit_window = false;
+    bool is_waiting_events = false;
+    double frame_start = GetTime();
     while (!exit_window) {
         if (WindowShouldClose()) exit_window = true;
+        if (IsKeyPressed(KEY_F3)) is_timing_overlay_shown = !is_timing_overlay_shown;
+
+        int screen_width  = GetScreenWidth();
+        int screen_height = GetScreenHeight();
+        double input_start = GetTime();
+        sample_input(screen_width, screen_height);
+        add_phase_time(PHASE_INPUT, input_start);
+        step_game();
 
         BeginDrawing();
-            int screen_width  = GetScreenWidth();
-            int screen_height = GetScreenHeight();
             ClearBackground(BACKGROUND_COLOR);
 
             switch (current_state) {
             case MENU:
                 render_menu(screen_width, screen_height); break;
-            case CHOOSE_DIFFICULTY:
-                render_difficulty_menu(screen_width, screen_height); break;
             case GAME:
                 render_game(screen_width, screen_height); break;
+            case PAUSE:
+                render_pause_screen(screen_width, screen_height); break;
             case WIN:
             case LOSE:
                 render_end_game_screen(screen_width, screen_height); break;
@@ -653,23 +1695,47 @@ int main(void)
             default:
                 break;
             }
+            render_buttons(screen_width, screen_height);
+            if (is_timing_overlay_shown) render_timing_overlay();
+
+            /* Only a running clock or the timing overlay need new frames
+             * on their own, otherwise sleep in EndDrawing() until input
+             * arrives */
+            bool is_idle = (current_state != GAME || !is_field_started()) && !is_timing_overlay_shown;
+            if (is_idle && !is_waiting_events) EnableEventWaiting();
+            else if (!is_idle && is_waiting_events) DisableEventWaiting();
+            is_waiting_events = is_idle;
+            double end_drawing_start = GetTime();
         EndDrawing();
+        add_phase_time(PHASE_END_DRAWING, end_drawing_start);
+        double frame_end = GetTime();
+        finish_frame_timing(frame_end - frame_start, end_drawing_start - frame_start);
+        frame_start = frame_end;
         if (IsKeyReleased(KEY_R)) {
                 TakeScreenshot("screen.png");
             }
     }
 
+    if (timing_csv_path != NULL && !export_timing_csv(timing_csv_path)) {
+        TraceLog(LOG_WARNING, "Could not write frame timing to %s", timing_csv_path);
+    }
+
+    finish_field_generation();
+    save_recording();
+    recording_free(&recording);
+
+    finish_next_board();
+    board_free(&boards[0]);
+    board_free(&boards[1]);
+    endless_free(&world);
+
     UnloadSound(open_cell_sound);
     CloseAudioDevice();
 
-    UnloadTexture(bomb_icon_texture);
-    UnloadImage(bomb_icon_image);
-
+    UnloadRenderTexture(field_cache);
+    UnloadTexture(cell_atlas_texture);
     UnloadTexture(clock_icon_texture);
-    UnloadImage(clock_icon_image);
-
     UnloadTexture(flag_icon_texture);
-    UnloadImage(flag_icon_image);
 
     UnloadFont(end_game_button_font);
     UnloadFont(field_font);
@@ -681,7 +1747,6 @@ int main(void)
 }
 
 
-// TODO: Generate field after first click
 // TODO: Change sound when open cell
 // TODO: Change flag icon color
 // TODO: Change clock icon color
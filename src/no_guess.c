@@ -0,0 +1,130 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include "no_guess.h"
+#include "solver.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define MAX_THREADS 64
+
+/* Candidates are shared out one at a time. Once one works, the ones
+ * numbered after it are skipped, those before it still finish so the
+ * lowest working one is found */
+typedef struct {
+    const Board *board;
+    int safe_x;
+    int safe_y;
+
+    pthread_mutex_t mutex;
+    int next_attempt;
+    int found_attempt;
+    int tried;
+} Search;
+
+
+int no_guess_default_threads(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = info.dwNumberOfProcessors;
+#else
+    int count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (count < 1) return 1;
+    return count < MAX_THREADS ? count : MAX_THREADS;
+}
+
+
+/* Seed of the board_generate() of a candidate. The first candidate is
+ * the board as it would be generated anyway */
+static uint64_t candidate_seed(uint64_t rng, int attempt)
+{
+    if (attempt == 0) return rng;
+    /* splitmix64 */
+    uint64_t z = rng + (uint64_t)attempt*0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+
+/* Play the candidate with the solver alone, opening all the cells it
+ * found safe before updating it again */
+static bool is_solvable(const Search *search, Board *candidate, Solver *solver, int attempt)
+{
+    if (!board_copy(candidate, search->board)) return false;
+    candidate->rng = candidate_seed(search->board->rng, attempt);
+    int opened = board_reveal(candidate, search->safe_x, search->safe_y);
+    while (opened > 0) {
+        solver_update(solver, candidate);
+        board_clear_changes(candidate);
+        opened = 0;
+        int x, y;
+        while (solver_next_safe(solver, candidate, &x, &y)) opened += board_reveal(candidate, x, y);
+    }
+    return board_get_status(candidate) == BOARD_WON;
+}
+
+
+static void *search_candidates(void *arg)
+{
+    Search *search = arg;
+    Board candidate = {0};
+    Solver solver = {0};
+    pthread_mutex_lock(&search->mutex);
+    while (search->next_attempt < search->found_attempt && search->next_attempt < NO_GUESS_MAX_ATTEMPTS) {
+        int attempt = search->next_attempt++;
+        search->tried++;
+        pthread_mutex_unlock(&search->mutex);
+
+        bool is_found = solver_reset(&solver, search->board) && is_solvable(search, &candidate, &solver, attempt);
+
+        pthread_mutex_lock(&search->mutex);
+        if (is_found && attempt < search->found_attempt) search->found_attempt = attempt;
+    }
+    pthread_mutex_unlock(&search->mutex);
+    solver_free(&solver);
+    board_free(&candidate);
+    return NULL;
+}
+
+
+bool no_guess_generate(Board *board, int safe_x, int safe_y, int threads, int *attempts)
+{
+    if (board->columns*board->rows > NO_GUESS_MAX_CELLS) {
+        if (attempts != NULL) *attempts = 0;
+        board_generate(board, safe_x, safe_y);
+        return false;
+    }
+
+    Search search = {
+        .board = board,
+        .safe_x = safe_x,
+        .safe_y = safe_y,
+        .found_attempt = INT_MAX,
+    };
+    pthread_mutex_init(&search.mutex, NULL);
+
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    pthread_t workers[MAX_THREADS];
+    int worker_count = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[worker_count], NULL, search_candidates, &search) != 0) break;
+        worker_count++;
+    }
+    search_candidates(&search);
+    for (int i = 0; i < worker_count; i++) pthread_join(workers[i], NULL);
+    pthread_mutex_destroy(&search.mutex);
+
+    if (attempts != NULL) *attempts = search.tried;
+    bool is_found = search.found_attempt != INT_MAX;
+    board->rng = candidate_seed(board->rng, is_found ? search.found_attempt : 0);
+    board_generate(board, safe_x, safe_y);
+    return is_found;
+}
@@ -0,0 +1,30 @@
+#ifndef NO_GUESS_H_
+#define NO_GUESS_H_
+
+#include <stdbool.h>
+#include "board.h"
+
+/* Boards that can be won from the first click without guessing: bomb
+ * layouts are drawn until the rule-based solver of solver.h wins one
+ * alone. Candidates are tried on several threads at once. */
+
+/* Give up after this many candidates, a dense board may have none */
+#define NO_GUESS_MAX_ATTEMPTS 5000
+/* Largest board it takes, the 30x16 expert board. Every thread copies the
+ * board and sizes a solver for it, and bigger boards are rarely won by
+ * the solver alone, so the attempts would pile up */
+#define NO_GUESS_MAX_CELLS (30*16)
+
+/* Count of threads to use by default, one per CPU */
+int no_guess_default_threads(void);
+
+/* Place the bombs of a board that has none yet, like board_generate(),
+ * so that the game opened at (safe_x, safe_y) can be won without a guess.
+ * The lowest numbered candidate that works is taken, so the result only
+ * depends on the board and not on the count of threads. Returns false and
+ * generates the board as board_generate() would if no candidate worked,
+ * or without trying any if it has more than NO_GUESS_MAX_CELLS cells.
+ * `attempts` receives the count of candidates tried and can be NULL */
+bool no_guess_generate(Board *board, int safe_x, int safe_y, int threads, int *attempts);
+
+#endif // NO_GUESS_H_
@@ -0,0 +1,778 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "probability.h"
+
+/* Probability.component_of of the cells the solver decided */
+#define DECIDED_CELL (-2)
+
+
+/* Enumeration state of one component */
+typedef struct {
+    int cell_count;
+    int *order;
+    /* Up to 8 constraints per cell */
+    int *cell_constraints;
+    int *cell_constraint_count;
+    int *bombs_needed;
+    int *unassigned;
+    uint8_t *assignment;
+    int bombs;
+    double *ways;
+    double *cell_ways;
+} Enumeration;
+
+
+static void enumerate(Enumeration *e, int depth)
+{
+    if (depth == e->cell_count) {
+        e->ways[e->bombs] += 1;
+        for (int i = 0; i < e->cell_count; i++) {
+            if (e->assignment[i]) e->cell_ways[i*(e->cell_count + 1) + e->bombs] += 1;
+        }
+        return;
+    }
+
+    int c = e->order[depth];
+    const int *constraints = &e->cell_constraints[c*8];
+    for (int value = 0; value <= 1; value++) {
+        bool is_possible = true;
+        for (int j = 0; j < e->cell_constraint_count[c]; j++) {
+            int k = constraints[j];
+            e->unassigned[k]--;
+            e->bombs_needed[k] -= value;
+            if (e->bombs_needed[k] < 0 || e->bombs_needed[k] > e->unassigned[k]) is_possible = false;
+        }
+        if (is_possible) {
+            e->assignment[c] = value;
+            e->bombs += value;
+            enumerate(e, depth + 1);
+            e->bombs -= value;
+        }
+        for (int j = 0; j < e->cell_constraint_count[c]; j++) {
+            int k = constraints[j];
+            e->unassigned[k]++;
+            e->bombs_needed[k] += value;
+        }
+    }
+}
+
+
+/* Count the configurations of a component from its signature. Cells are
+ * assigned in breadth-first order through the constraints, so every
+ * constraint is closed soon after it is opened and dead ends are cut
+ * early */
+static void enumerate_component(Component_Result *result)
+{
+    const int *signature = result->signature;
+    int n = signature[0];
+    int constraint_count = signature[1];
+
+    int *scratch = malloc((n*8 + n*2 + constraint_count*3)*sizeof(*scratch) + n*2);
+    if (scratch == NULL) {
+        result->is_ok = false;
+        return;
+    }
+    Enumeration e = {
+        .cell_count = n,
+        .order = scratch,
+        .cell_constraints = scratch + n,
+        .cell_constraint_count = scratch + n*9,
+        .bombs_needed = scratch + n*10,
+        .unassigned = scratch + n*10 + constraint_count,
+        .ways = result->ways,
+        .cell_ways = result->cell_ways,
+    };
+    int *constraint_offsets = scratch + n*10 + constraint_count*2;
+    e.assignment = (uint8_t *)(scratch + n*10 + constraint_count*3);
+    uint8_t *is_visited = e.assignment + n;
+    memset(e.cell_constraint_count, 0, n*sizeof(*e.cell_constraint_count));
+    memset(is_visited, 0, n);
+
+    int offset = 2;
+    for (int k = 0; k < constraint_count; k++) {
+        constraint_offsets[k] = offset;
+        e.bombs_needed[k] = signature[offset];
+        e.unassigned[k] = signature[offset + 1];
+        for (int j = 0; j < e.unassigned[k]; j++) {
+            int c = signature[offset + 2 + j];
+            e.cell_constraints[c*8 + e.cell_constraint_count[c]++] = k;
+        }
+        offset += 2 + e.unassigned[k];
+    }
+
+    int ordered = 0;
+    for (int start = 0; start < n; start++) {
+        if (is_visited[start]) continue;
+        is_visited[start] = 1;
+        e.order[ordered++] = start;
+        for (int next = ordered - 1; next < ordered; next++) {
+            int c = e.order[next];
+            for (int j = 0; j < e.cell_constraint_count[c]; j++) {
+                const int *constraint = &signature[constraint_offsets[e.cell_constraints[c*8 + j]]];
+                for (int i = 0; i < constraint[1]; i++) {
+                    int other = constraint[2 + i];
+                    if (is_visited[other]) continue;
+                    is_visited[other] = 1;
+                    e.order[ordered++] = other;
+                }
+            }
+        }
+    }
+
+    memset(result->ways, 0, (n + 1)*sizeof(*result->ways));
+    memset(result->cell_ways, 0, (size_t)n*(n + 1)*sizeof(*result->cell_ways));
+    enumerate(&e, 0);
+    free(scratch);
+
+    double max_ways = 0;
+    for (int k = 0; k <= n; k++) max_ways = fmax(max_ways, result->ways[k]);
+    if (max_ways > 0) {
+        for (int k = 0; k <= n; k++) result->ways[k] /= max_ways;
+        for (int i = 0; i < n*(n + 1); i++) result->cell_ways[i] /= max_ways;
+    }
+    result->is_ok = true;
+}
+
+
+static void *probability_worker(void *arg)
+{
+    Probability *engine = arg;
+    pthread_mutex_lock(&engine->mutex);
+    for (;;) {
+        while (!engine->is_stopping && engine->next_job >= engine->job_count) {
+            pthread_cond_wait(&engine->work_ready, &engine->mutex);
+        }
+        if (engine->is_stopping) break;
+        Component_Result *job = engine->jobs[engine->next_job++];
+        pthread_mutex_unlock(&engine->mutex);
+        enumerate_component(job);
+        pthread_mutex_lock(&engine->mutex);
+        if (++engine->done_jobs == engine->job_count) pthread_cond_signal(&engine->work_done);
+    }
+    pthread_mutex_unlock(&engine->mutex);
+    return NULL;
+}
+
+
+/* Enumerate the jobs on the workers and the calling thread */
+static void run_jobs(Probability *engine, int job_count)
+{
+    pthread_mutex_lock(&engine->mutex);
+    engine->job_count = job_count;
+    engine->next_job = 0;
+    engine->done_jobs = 0;
+    if (engine->thread_count > 0 && job_count > 1) pthread_cond_broadcast(&engine->work_ready);
+    while (engine->next_job < engine->job_count) {
+        Component_Result *job = engine->jobs[engine->next_job++];
+        pthread_mutex_unlock(&engine->mutex);
+        enumerate_component(job);
+        pthread_mutex_lock(&engine->mutex);
+        engine->done_jobs++;
+    }
+    while (engine->done_jobs < engine->job_count) pthread_cond_wait(&engine->work_done, &engine->mutex);
+    engine->job_count = 0;
+    engine->next_job = 0;
+    pthread_mutex_unlock(&engine->mutex);
+}
+
+
+bool probability_init(Probability *engine, int threads)
+{
+    memset(engine, 0, sizeof(*engine));
+    pthread_mutex_init(&engine->mutex, NULL);
+    pthread_cond_init(&engine->work_ready, NULL);
+    pthread_cond_init(&engine->work_done, NULL);
+    if (threads <= 0) return true;
+
+    engine->threads = malloc(threads*sizeof(*engine->threads));
+    if (engine->threads == NULL) return false;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&engine->threads[i], NULL, probability_worker, engine) != 0) break;
+        engine->thread_count++;
+    }
+    return engine->thread_count == threads;
+}
+
+
+static void free_result(Component_Result *result)
+{
+    free(result->signature);
+    free(result->ways);
+    free(result->cell_ways);
+}
+
+
+void probability_free(Probability *engine)
+{
+    pthread_mutex_lock(&engine->mutex);
+    engine->is_stopping = true;
+    pthread_cond_broadcast(&engine->work_ready);
+    pthread_mutex_unlock(&engine->mutex);
+    for (int i = 0; i < engine->thread_count; i++) pthread_join(engine->threads[i], NULL);
+    pthread_cond_destroy(&engine->work_done);
+    pthread_cond_destroy(&engine->work_ready);
+    pthread_mutex_destroy(&engine->mutex);
+
+    for (int i = 0; i < engine->result_count; i++) free_result(&engine->results[i]);
+    for (int i = 0; i < engine->slot_capacity; i++) {
+        free(engine->components[i].cells);
+        free(engine->components[i].counts);
+    }
+    free(engine->results);
+    free(engine->result_remap);
+    free(engine->jobs);
+    free(engine->threads);
+    free(engine->probabilities);
+    free(engine->component_of);
+    free(engine->components);
+    free(engine->free_slots);
+    free(engine->enumerated);
+    free(engine->stack);
+    free(engine->marks);
+    free(engine->local_index);
+    free(engine->signature);
+    memset(engine, 0, sizeof(*engine));
+}
+
+
+static bool reserve_scratch(Probability *engine, int cells)
+{
+    if (cells <= engine->capacity) return true;
+
+    double *probabilities = realloc(engine->probabilities, cells*sizeof(*probabilities));
+    if (probabilities == NULL) return false;
+    engine->probabilities = probabilities;
+
+    int **arrays[] = {
+        &engine->component_of,
+        &engine->stack,
+        &engine->marks,
+        &engine->local_index,
+    };
+    for (size_t i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++) {
+        int *array = realloc(*arrays[i], cells*sizeof(int));
+        if (array == NULL) return false;
+        *arrays[i] = array;
+    }
+    engine->capacity = cells;
+    return true;
+}
+
+
+/* Undecided neighbours of an open count and the bombs among them.
+ * Returns count of the neighbours */
+static int get_unknowns(const Probability *engine, const Board *board, const Solver *solver,
+                        int cell_index, int *unknowns, int *bombs)
+{
+    int x = cell_index % engine->columns;
+    int y = cell_index / engine->columns;
+    int count = 0;
+    *bombs = cell_bombs_around(board->cells[cell_index]);
+    for (int sy = -1; sy <= 1; sy++) {
+        for (int sx = -1; sx <= 1; sx++) {
+            if (sx == 0 && sy == 0) continue;
+            if (x + sx < 0 || x + sx >= engine->columns) continue;
+            if (y + sy < 0 || y + sy >= engine->rows) continue;
+            int neighbour_index = (y + sy)*engine->columns + (x + sx);
+            uint8_t neighbour = solver->cells[neighbour_index];
+            if ((neighbour & SOLVER_BOMB_BIT) != 0) (*bombs)--;
+            else if ((neighbour & SOLVER_SAFE_BIT) == 0) unknowns[count++] = neighbour_index;
+        }
+    }
+    return count;
+}
+
+
+static uint64_t hash_signature(const int *signature, int length)
+{
+    /* FNV-1a */
+    uint64_t hash = 0xCBF29CE484222325ull;
+    const uint8_t *bytes = (const uint8_t *)signature;
+    for (size_t i = 0; i < length*sizeof(*signature); i++) hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+
+/* Find the result of a signature or add an empty one for it. Returns its
+ * index or -1 if memory ran out */
+static int find_result(Probability *engine, const int *signature, int length)
+{
+    uint64_t hash = hash_signature(signature, length);
+    for (int i = 0; i < engine->result_count; i++) {
+        Component_Result *result = &engine->results[i];
+        if (result->hash != hash || result->signature_length != length) continue;
+        if (memcmp(result->signature, signature, length*sizeof(*signature)) != 0) continue;
+        result->last_used = engine->generation;
+        engine->cache_hits++;
+        return i;
+    }
+
+    if (engine->result_count >= engine->result_capacity) {
+        int capacity = engine->result_capacity == 0 ? 64 : engine->result_capacity*2;
+        Component_Result *results = realloc(engine->results, capacity*sizeof(*results));
+        if (results == NULL) return -1;
+        engine->results = results;
+        int *result_remap = realloc(engine->result_remap, capacity*sizeof(*result_remap));
+        if (result_remap == NULL) return -1;
+        engine->result_remap = result_remap;
+        engine->result_capacity = capacity;
+    }
+    int n = signature[0];
+    Component_Result result = {
+        .hash = hash,
+        .signature = malloc(length*sizeof(*signature)),
+        .signature_length = length,
+        .cell_count = n,
+        .ways = malloc((n + 1)*sizeof(double)),
+        .cell_ways = malloc((size_t)n*(n + 1)*sizeof(double)),
+        .last_used = engine->generation,
+    };
+    if (result.signature == NULL || result.ways == NULL || result.cell_ways == NULL) {
+        free_result(&result);
+        return -1;
+    }
+    memcpy(result.signature, signature, length*sizeof(*signature));
+    engine->results[engine->result_count] = result;
+    return engine->result_count++;
+}
+
+
+static inline bool is_undecided(const Solver *solver, int cell_index)
+{
+    return (solver->cells[cell_index] & (SOLVER_SAFE_BIT | SOLVER_BOMB_BIT)) == 0;
+}
+
+
+static bool has_open_neighbour(const Probability *engine, const Solver *solver, int cell_index)
+{
+    int x = cell_index % engine->columns;
+    int y = cell_index / engine->columns;
+    for (int sy = -1; sy <= 1; sy++) {
+        for (int sx = -1; sx <= 1; sx++) {
+            if (x + sx < 0 || x + sx >= engine->columns) continue;
+            if (y + sy < 0 || y + sy >= engine->rows) continue;
+            if ((solver->cells[(y + sy)*engine->columns + (x + sx)] & SOLVER_OPEN_BIT) != 0) return true;
+        }
+    }
+    return false;
+}
+
+
+/* Returns a free component slot or -1 if memory ran out */
+static int new_component(Probability *engine)
+{
+    if (engine->free_count > 0) return engine->free_slots[--engine->free_count];
+    if (engine->slot_count >= engine->slot_capacity) {
+        int capacity = engine->slot_capacity == 0 ? 64 : engine->slot_capacity*2;
+        Component *components = realloc(engine->components, capacity*sizeof(*components));
+        if (components == NULL) return -1;
+        engine->components = components;
+        memset(&components[engine->slot_capacity], 0, (capacity - engine->slot_capacity)*sizeof(*components));
+        engine->slot_capacity = capacity;
+        int *free_slots = realloc(engine->free_slots, capacity*sizeof(*free_slots));
+        if (free_slots == NULL) return -1;
+        engine->free_slots = free_slots;
+        int *enumerated = realloc(engine->enumerated, capacity*sizeof(*enumerated));
+        if (enumerated == NULL) return -1;
+        engine->enumerated = enumerated;
+    }
+    return engine->slot_count++;
+}
+
+
+static bool add_to_component(Component *component, int cell_index, bool is_count)
+{
+    int count = component->cell_count > component->count_count ? component->cell_count : component->count_count;
+    if (count >= component->capacity) {
+        int capacity = component->capacity == 0 ? 16 : component->capacity*2;
+        int *cells = realloc(component->cells, capacity*sizeof(*cells));
+        if (cells == NULL) return false;
+        component->cells = cells;
+        int *counts = realloc(component->counts, capacity*sizeof(*counts));
+        if (counts == NULL) return false;
+        component->counts = counts;
+        component->capacity = capacity;
+    }
+    if (is_count) component->counts[component->count_count++] = cell_index;
+    else component->cells[component->cell_count++] = cell_index;
+    return true;
+}
+
+
+static int compare_ints(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+
+/* Gather the component of the frontier cell `start` through the counts
+ * over its cells. Returns false if memory ran out */
+static bool gather_component(Probability *engine, const Solver *solver, int start)
+{
+    int slot = new_component(engine);
+    if (slot < 0) return false;
+    Component *component = &engine->components[slot];
+    component->cell_count = 0;
+    component->count_count = 0;
+    component->result = -1;
+    component->is_used = true;
+    engine->component_count++;
+
+    int stamp = ++engine->stamp;
+    int *stack = engine->stack;
+    int stack_size = 0;
+    engine->component_of[start] = slot;
+    stack[stack_size++] = start;
+    while (stack_size > 0) {
+        int cell_index = stack[--stack_size];
+        if (!add_to_component(component, cell_index, false)) return false;
+        int x = cell_index % engine->columns;
+        int y = cell_index / engine->columns;
+        for (int sy = -1; sy <= 1; sy++) {
+            for (int sx = -1; sx <= 1; sx++) {
+                if (x + sx < 0 || x + sx >= engine->columns) continue;
+                if (y + sy < 0 || y + sy >= engine->rows) continue;
+                int count_index = (y + sy)*engine->columns + (x + sx);
+                if ((solver->cells[count_index] & SOLVER_OPEN_BIT) == 0) continue;
+                if (engine->marks[count_index] == stamp) continue;
+                engine->marks[count_index] = stamp;
+                if (!add_to_component(component, count_index, true)) return false;
+
+                for (int ny = y + sy - 1; ny <= y + sy + 1; ny++) {
+                    for (int nx = x + sx - 1; nx <= x + sx + 1; nx++) {
+                        if (nx < 0 || nx >= engine->columns || ny < 0 || ny >= engine->rows) continue;
+                        int neighbour_index = ny*engine->columns + nx;
+                        if (!is_undecided(solver, neighbour_index) || engine->component_of[neighbour_index] >= 0) continue;
+                        engine->component_of[neighbour_index] = slot;
+                        stack[stack_size++] = neighbour_index;
+                    }
+                }
+            }
+        }
+    }
+
+    qsort(component->cells, component->cell_count, sizeof(*component->cells), compare_ints);
+    qsort(component->counts, component->count_count, sizeof(*component->counts), compare_ints);
+    /* Too big to enumerate, its cells take the density of the bombs left */
+    if (component->cell_count > PROBABILITY_MAX_COMPONENT_CELLS) {
+        for (int i = 0; i < component->cell_count; i++) engine->probabilities[component->cells[i]] = -1;
+    }
+    return true;
+}
+
+
+/* Take the cells of a component back out of the frontier, into the
+ * cells to gather again */
+static void dissolve_component(Probability *engine, int slot, int *seeds, int *seed_count, int stamp)
+{
+    Component *component = &engine->components[slot];
+    for (int i = 0; i < component->cell_count; i++) {
+        int cell_index = component->cells[i];
+        engine->component_of[cell_index] = -1;
+        engine->marks[cell_index] = stamp;
+        seeds[(*seed_count)++] = cell_index;
+    }
+    component->is_used = false;
+    engine->free_slots[engine->free_count++] = slot;
+    engine->component_count--;
+}
+
+
+/* Count a cell the solver decided and give it its probability */
+static void take_in_cell(Probability *engine, const Solver *solver, int cell_index)
+{
+    uint8_t c = solver->cells[cell_index];
+    if ((c & (SOLVER_SAFE_BIT | SOLVER_BOMB_BIT)) == 0 || engine->component_of[cell_index] == DECIDED_CELL) return;
+    engine->component_of[cell_index] = DECIDED_CELL;
+    engine->undecided_count--;
+    engine->known_bombs += (c & SOLVER_BOMB_BIT) != 0;
+    engine->probabilities[cell_index] = (c & SOLVER_BOMB_BIT) != 0 ? 1 : 0;
+}
+
+
+/* Bring the components up to date with the cells the solver changed. A
+ * changed cell leaves the frontier, changes the counts next to it and,
+ * once open, adds a count over its neighbours, so only the components of
+ * the cells up to two cells away change. Returns false if memory ran
+ * out */
+static bool update_components(Probability *engine, const Board *board, const Solver *solver)
+{
+    int cells = board->columns*board->rows;
+    bool is_new_board = solver->is_all_changed || board->columns != engine->columns || board->rows != engine->rows;
+    if (is_new_board) {
+        if (!reserve_scratch(engine, cells)) return false;
+        engine->columns = board->columns;
+        engine->rows = board->rows;
+        for (int slot = 0; slot < engine->slot_count; slot++) engine->components[slot].is_used = false;
+        engine->slot_count = 0;
+        engine->free_count = 0;
+        engine->component_count = 0;
+        engine->undecided_count = cells;
+        engine->known_bombs = 0;
+        for (int i = 0; i < cells; i++) {
+            engine->probabilities[i] = -1;
+            engine->component_of[i] = -1;
+            engine->marks[i] = 0;
+        }
+        engine->stamp = 0;
+        for (int i = 0; i < cells; i++) take_in_cell(engine, solver, i);
+        for (int i = 0; i < cells; i++) {
+            if (!is_undecided(solver, i) || engine->component_of[i] >= 0) continue;
+            if (!has_open_neighbour(engine, solver, i)) continue;
+            if (!gather_component(engine, solver, i)) return false;
+        }
+        return true;
+    }
+
+    /* The seeds borrow the scratch of the signatures, which come after.
+     * Marked seeds are not listed twice, so they fit */
+    int *seeds = engine->local_index;
+    int seed_count = 0;
+    int stamp = ++engine->stamp;
+    for (int i = 0; i < solver->change_count; i++) {
+        int cell_index = solver->changes[i];
+        int x = cell_index % engine->columns;
+        int y = cell_index / engine->columns;
+        for (int sy = -2; sy <= 2; sy++) {
+            for (int sx = -2; sx <= 2; sx++) {
+                if (x + sx < 0 || x + sx >= engine->columns) continue;
+                if (y + sy < 0 || y + sy >= engine->rows) continue;
+                int other_index = (y + sy)*engine->columns + (x + sx);
+                int slot = engine->component_of[other_index];
+                if (slot >= 0) {
+                    dissolve_component(engine, slot, seeds, &seed_count, stamp);
+                } else if (slot == -1 && sx >= -1 && sx <= 1 && sy >= -1 && sy <= 1 &&
+                           engine->marks[other_index] != stamp) {
+                    /* Undecided neighbours of a new count join the frontier */
+                    engine->marks[other_index] = stamp;
+                    seeds[seed_count++] = other_index;
+                }
+            }
+        }
+        take_in_cell(engine, solver, cell_index);
+    }
+
+    for (int i = 0; i < seed_count; i++) {
+        int cell_index = seeds[i];
+        if (!is_undecided(solver, cell_index) || engine->component_of[cell_index] >= 0) continue;
+        if (!has_open_neighbour(engine, solver, cell_index)) continue;
+        if (!gather_component(engine, solver, cell_index)) return false;
+    }
+    return true;
+}
+/* Multiply two polynomials of bomb counts, scaled so the largest
+ * coefficient is 1. Returns the degree of the product */
+static int convolve(const double *a, int a_degree, const double *b, int b_degree, double *product)
+{
+    int degree = a_degree + b_degree;
+    for (int m = 0; m <= degree; m++) product[m] = 0;
+    for (int i = 0; i <= a_degree; i++) {
+        if (a[i] == 0) continue;
+        for (int j = 0; j <= b_degree; j++) product[i + j] += a[i]*b[j];
+    }
+    double max = 0;
+    for (int m = 0; m <= degree; m++) max = fmax(max, product[m]);
+    if (max > 0) {
+        for (int m = 0; m <= degree; m++) product[m] /= max;
+    }
+    return degree;
+}
+
+
+/* Look up or enumerate the result of every component small enough.
+ * Returns false if memory ran out */
+static bool enumerate_components(Probability *engine, const Board *board, const Solver *solver)
+{
+    int first_new_result = engine->result_count;
+    int unknowns[8];
+    int bombs;
+    engine->cache_hits = 0;
+    engine->estimated_count = 0;
+    engine->enumerated_count = 0;
+    for (int slot = 0; slot < engine->slot_count; slot++) {
+        Component *component = &engine->components[slot];
+        if (!component->is_used) continue;
+        int n = component->cell_count;
+        if (n > PROBABILITY_MAX_COMPONENT_CELLS) {
+            engine->estimated_count++;
+            continue;
+        }
+        engine->enumerated[engine->enumerated_count++] = slot;
+        if (component->result >= 0) {
+            engine->results[component->result].last_used = engine->generation;
+            engine->cache_hits++;
+            continue;
+        }
+
+        int max_length = 2 + component->count_count*10;
+        if (max_length > engine->signature_capacity) {
+            int *signature = realloc(engine->signature, max_length*sizeof(*signature));
+            if (signature == NULL) return false;
+            engine->signature = signature;
+            engine->signature_capacity = max_length;
+        }
+        for (int i = 0; i < n; i++) engine->local_index[component->cells[i]] = i;
+
+        int *signature = engine->signature;
+        int length = 0;
+        signature[length++] = n;
+        signature[length++] = component->count_count;
+        for (int j = 0; j < component->count_count; j++) {
+            int count = get_unknowns(engine, board, solver, component->counts[j], unknowns, &bombs);
+            signature[length++] = bombs;
+            signature[length++] = count;
+            for (int i = 0; i < count; i++) signature[length++] = engine->local_index[unknowns[i]];
+        }
+
+        component->result = find_result(engine, signature, length);
+        if (component->result < 0) return false;
+    }
+
+    int job_count = engine->result_count - first_new_result;
+    if (job_count > 0) {
+        Component_Result **jobs = realloc(engine->jobs, job_count*sizeof(*jobs));
+        if (jobs == NULL) return false;
+        engine->jobs = jobs;
+        for (int i = 0; i < job_count; i++) jobs[i] = &engine->results[first_new_result + i];
+        run_jobs(engine, job_count);
+    }
+    for (int i = first_new_result; i < engine->result_count; i++) {
+        if (!engine->results[i].is_ok) return false;
+    }
+    return true;
+}
+
+
+/* Keep only the results of the components on the board now */
+static void drop_unused_results(Probability *engine)
+{
+    int kept = 0;
+    for (int i = 0; i < engine->result_count; i++) {
+        if (engine->results[i].last_used == engine->generation) {
+            engine->result_remap[i] = kept;
+            engine->results[kept++] = engine->results[i];
+        } else {
+            free_result(&engine->results[i]);
+        }
+    }
+    engine->result_count = kept;
+    for (int i = 0; i < engine->enumerated_count; i++) {
+        Component *component = &engine->components[engine->enumerated[i]];
+        component->result = engine->result_remap[component->result];
+    }
+}
+
+
+static const Component_Result *enumerated_result(const Probability *engine, int i)
+{
+    return &engine->results[engine->components[engine->enumerated[i]].result];
+}
+
+
+/* Configurations of every enumerated component except `skip` (-1 for
+ * none) by their bomb count. Returns the degree */
+static int convolve_components(const Probability *engine, int skip, double *out, double *scratch)
+{
+    int degree = 0;
+    out[0] = 1;
+    for (int c = 0; c < engine->enumerated_count; c++) {
+        if (c == skip) continue;
+        const Component_Result *result = enumerated_result(engine, c);
+        degree = convolve(out, degree, result->ways, result->cell_count, scratch);
+        memcpy(out, scratch, (degree + 1)*sizeof(*out));
+    }
+    return degree;
+}
+
+
+bool probability_compute(Probability *engine, const Board *board, const Solver *solver)
+{
+    engine->generation++;
+    if (!update_components(engine, board, solver)) return false;
+    if (!enumerate_components(engine, board, solver)) return false;
+
+    /* Bombs left for the undecided cells, and the cells that take their
+     * density: those away from the frontier and those of the components
+     * too big to enumerate */
+    int bombs_left = board->bombs - engine->known_bombs;
+    int frontier = 0;
+    for (int c = 0; c < engine->enumerated_count; c++) frontier += enumerated_result(engine, c)->cell_count;
+    int interior = engine->undecided_count - frontier;
+
+    double *weights = malloc((frontier + 1)*4*sizeof(*weights));
+    if (weights == NULL) return false;
+    double *binomials = weights;
+    double *others = weights + (frontier + 1);
+    double *scratch = weights + (frontier + 1)*2;
+    double *totals = weights + (frontier + 1)*3;
+
+    /* binomials[m]: ways to put the rest of the bombs in the interior when
+     * the frontier holds m, relative to the largest */
+    double max_log = -INFINITY;
+    for (int m = 0; m <= frontier; m++) {
+        int rest = bombs_left - m;
+        binomials[m] = rest < 0 || rest > interior ? -INFINITY :
+            lgamma(interior + 1) - lgamma(rest + 1) - lgamma(interior - rest + 1);
+        max_log = fmax(max_log, binomials[m]);
+    }
+    for (int m = 0; m <= frontier; m++) binomials[m] = exp(binomials[m] - max_log);
+
+    int degree = convolve_components(engine, -1, others, scratch);
+    double total = 0;
+    double interior_bombs = 0;
+    for (int m = 0; m <= degree; m++) {
+        total += others[m]*binomials[m];
+        interior_bombs += others[m]*binomials[m]*(bombs_left - m);
+    }
+    if (total <= 0) {
+        free(weights);
+        return false;
+    }
+    engine->interior_probability = interior > 0 ? interior_bombs/total/interior : 0;
+
+    for (int c = 0; c < engine->enumerated_count; c++) {
+        const Component *component = &engine->components[engine->enumerated[c]];
+        const Component_Result *result = enumerated_result(engine, c);
+        int n = result->cell_count;
+        degree = convolve_components(engine, c, others, scratch);
+
+        /* totals[k]: weight of the rest of the board when the component
+         * holds k bombs */
+        double component_total = 0;
+        for (int k = 0; k <= n; k++) {
+            totals[k] = 0;
+            for (int m = 0; m <= degree; m++) totals[k] += others[m]*binomials[k + m];
+            component_total += result->ways[k]*totals[k];
+        }
+        for (int i = 0; i < n; i++) {
+            double bomb_weight = 0;
+            for (int k = 0; k <= n; k++) bomb_weight += result->cell_ways[i*(n + 1) + k]*totals[k];
+            engine->probabilities[component->cells[i]] = bomb_weight/component_total;
+        }
+    }
+    free(weights);
+
+    drop_unused_results(engine);
+    return true;
+}
+
+
+bool probability_safest_cell(const Probability *engine, const Board *board, const Solver *solver, int *x, int *y)
+{
+    int best = -1;
+    double best_probability = 0;
+    for (int i = 0; i < engine->columns*engine->rows; i++) {
+        if (cell_get_state(board->cells[i]) == OPEN) continue;
+        if ((solver->cells[i] & SOLVER_BOMB_BIT) != 0) continue;
+        double probability = probability_of(engine, i % engine->columns, i / engine->columns);
+        if (best < 0 || probability < best_probability) {
+            best = i;
+            best_probability = probability;
+        }
+    }
+    if (best < 0) return false;
+    *x = best % engine->columns;
+    *y = best / engine->columns;
+    return true;
+}
@@ -0,0 +1,142 @@
+#ifndef PROBABILITY_H_
+#define PROBABILITY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "board.h"
+#include "solver.h"
+
+/* Exact bomb probabilities of the cells a Solver could not decide.
+ *
+ * The frontier (undecided cells next to an open count) is split into
+ * components that share no count. The bomb configurations of every
+ * component are enumerated and counted by their number of bombs, then
+ * the components and the cells away from the frontier are combined
+ * under the board's total bomb count.
+ *
+ * The components are kept between calls and only those within two cells
+ * of a cell the solver opened or decided are gathered again. Components
+ * are enumerated on a pool of worker threads and their results are kept
+ * by the shape of their counts, so an unchanged shape is not enumerated
+ * again. Enumeration is exponential in the size of a component: above
+ * PROBABILITY_MAX_COMPONENT_CELLS cells a component is not enumerated and
+ * its cells take the density of the bombs left, like the cells away from
+ * the frontier. */
+
+/* Components of up to 40 cells enumerate in a few milliseconds at worst,
+ * ten more cells can take 80 ms */
+#define PROBABILITY_MAX_COMPONENT_CELLS 40
+
+/* Enumeration result of one component shape */
+typedef struct {
+    uint64_t hash;
+    /* Cell count, count of constraints, then per constraint its bombs, its
+     * cell count and its cells as indices into the component's cells */
+    int *signature;
+    int signature_length;
+    int cell_count;
+    /* ways[k]: configurations with k bombs, scaled so the largest is 1.
+     * cell_ways[i*(cell_count + 1) + k]: those of them with a bomb in
+     * cell i */
+    double *ways;
+    double *cell_ways;
+    /* False if the enumeration ran out of memory */
+    bool is_ok;
+    int last_used;
+} Component_Result;
+
+/* Frontier cells connected through the open counts over them */
+typedef struct {
+    /* Both in row-major order */
+    int *cells;
+    int cell_count;
+    int *counts;
+    int count_count;
+    int capacity;
+    /* Index into Probability.results, -1 until looked up and for the
+     * components too big to enumerate */
+    int result;
+    bool is_used;
+} Component;
+
+typedef struct {
+    int columns;
+    int rows;
+    int capacity;
+    /* Bomb probability of the decided cells and of the enumerated frontier
+     * cells, negative for the cells that take interior_probability */
+    double *probabilities;
+    double interior_probability;
+
+    /* Cells neither known safe nor known bombs, and the known bombs */
+    int undecided_count;
+    int known_bombs;
+    /* Component of every frontier cell, -1 for the other undecided cells
+     * and -2 for the decided ones */
+    int *component_of;
+    Component *components;
+    int slot_count;
+    int slot_capacity;
+    int *free_slots;
+    int free_count;
+
+    /* Scratch of probability_compute() */
+    int *stack;
+    int *marks;
+    int stamp;
+    int *local_index;
+    /* Slots of the components small enough to enumerate */
+    int *enumerated;
+    int enumerated_count;
+    int *signature;
+    int signature_capacity;
+    int *result_remap;
+
+    Component_Result *results;
+    int result_count;
+    int result_capacity;
+    int generation;
+
+    /* Worker pool, idle between calls */
+    pthread_t *threads;
+    int thread_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    Component_Result **jobs;
+    int job_count;
+    int next_job;
+    int done_jobs;
+    bool is_stopping;
+
+    /* Statistics of the last probability_compute(): components, those
+     * whose result was kept and those too big to enumerate */
+    int component_count;
+    int cache_hits;
+    int estimated_count;
+} Probability;
+
+/* Start `threads` workers besides the calling thread, 0 computes
+ * everything on the calling thread */
+bool probability_init(Probability *engine, int threads);
+void probability_free(Probability *engine);
+
+/* Compute the probabilities of every cell of `board`. `solver` must be
+ * updated to the current board, its decided cells get 0 or 1. Only the
+ * cells the solver changed since the last solver_clear_changes() are
+ * taken in; the caller clears them. Returns false if the open counts
+ * contradict each other or memory ran out */
+bool probability_compute(Probability *engine, const Board *board, const Solver *solver);
+
+static inline double probability_of(const Probability *engine, int x, int y)
+{
+    double probability = engine->probabilities[y*engine->columns + x];
+    return probability < 0 ? engine->interior_probability : probability;
+}
+
+/* The closed cell least likely to hold a bomb, the first in row-major
+ * order on ties. Returns false if every closed cell is a known bomb */
+bool probability_safest_cell(const Probability *engine, const Board *board, const Solver *solver, int *x, int *y);
+
+#endif // PROBABILITY_H_
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+#include "no_guess.h"
+
+#define REPLAY_MAGIC   "MSRP"
+#define REPLAY_VERSION 1
+
+#define FLAG_NO_GUESS 0x01
+
+/* Longest encoding of an event: two varints of up to 5 bytes, the type
+ * and a third varint */
+#define MAX_EVENT_SIZE 16
+/* Magic, version, seed, size, bomb percent, flags, event count */
+#define MAX_HEADER_SIZE 32
+/* Status, score, hash */
+#define MAX_FOOTER_SIZE 16
+
+
+void recording_start(Recording *recording, uint64_t seed, int columns, int rows, float bomb_percent)
+{
+    recording->seed = seed;
+    recording->columns = columns;
+    recording->rows = rows;
+    recording->bomb_percent = bomb_percent;
+    recording->is_no_guess = false;
+    recording->event_count = 0;
+    recording->final_status = BOARD_PLAYING;
+    recording->final_score = 0;
+    recording->final_hash = 0;
+}
+
+
+bool recording_add_event(Recording *recording, replay_event_type type, uint32_t time_ms, int x, int y)
+{
+    if (recording->event_count >= recording->event_capacity) {
+        int capacity = recording->event_capacity == 0 ? 256 : recording->event_capacity*2;
+        Replay_Event *events = realloc(recording->events, capacity*sizeof(*recording->events));
+        if (events == NULL) return false;
+        recording->events = events;
+        recording->event_capacity = capacity;
+    }
+    recording->events[recording->event_count++] = (Replay_Event){
+        .time_ms = time_ms,
+        .type = type,
+        .x = x,
+        .y = y,
+    };
+    return true;
+}
+
+
+void recording_finish(Recording *recording, const Board *board)
+{
+    recording->final_status = board_get_status(board);
+    recording->final_score = board->score;
+    recording->final_hash = board_hash(board);
+}
+
+
+void recording_free(Recording *recording)
+{
+    free(recording->events);
+    memset(recording, 0, sizeof(*recording));
+}
+
+
+static uint8_t *put_varint(uint8_t *out, uint32_t value)
+{
+    while (value >= 0x80) {
+        *out++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *out++ = value;
+    return out;
+}
+
+static uint8_t *put_u64(uint8_t *out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) *out++ = value >> (8*i);
+    return out;
+}
+
+
+bool recording_save(const Recording *recording, const char *file_path)
+{
+    size_t size = MAX_HEADER_SIZE + (size_t)recording->event_count*MAX_EVENT_SIZE + MAX_FOOTER_SIZE;
+    uint8_t *data = malloc(size);
+    if (data == NULL) return false;
+
+    uint32_t bomb_percent_bits;
+    memcpy(&bomb_percent_bits, &recording->bomb_percent, sizeof(bomb_percent_bits));
+
+    uint8_t *out = data;
+    memcpy(out, REPLAY_MAGIC, 4);
+    out += 4;
+    *out++ = REPLAY_VERSION;
+    out = put_u64(out, recording->seed, 8);
+    out = put_u64(out, recording->columns, 2);
+    out = put_u64(out, recording->rows, 2);
+    out = put_u64(out, bomb_percent_bits, 4);
+    *out++ = recording->is_no_guess ? FLAG_NO_GUESS : 0;
+    out = put_varint(out, recording->event_count);
+
+    uint32_t previous_time = 0;
+    for (int i = 0; i < recording->event_count; i++) {
+        const Replay_Event *event = &recording->events[i];
+        uint32_t time = event->time_ms > previous_time ? event->time_ms : previous_time;
+        out = put_varint(out, time - previous_time);
+        *out++ = event->type;
+        out = put_varint(out, event->x);
+        out = put_varint(out, event->y);
+        previous_time = time;
+    }
+
+    *out++ = recording->final_status;
+    out = put_varint(out, recording->final_score);
+    out = put_u64(out, recording->final_hash, 8);
+
+    FILE *file = fopen(file_path, "wb");
+    bool ok = file != NULL && fwrite(data, 1, out - data, file) == (size_t)(out - data);
+    if (file != NULL && fclose(file) != 0) ok = false;
+    free(data);
+    return ok;
+}
+
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t position;
+    bool ok;
+} Reader;
+
+static uint64_t get_u64(Reader *reader, int bytes)
+{
+    if (reader->position + bytes > reader->size) {
+        reader->ok = false;
+        return 0;
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= (uint64_t)reader->data[reader->position++] << (8*i);
+    return value;
+}
+
+static uint32_t get_varint(Reader *reader)
+{
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (reader->position >= reader->size) break;
+        uint8_t byte = reader->data[reader->position++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return value;
+    }
+    reader->ok = false;
+    return 0;
+}
+
+
+bool recording_load(Recording *recording, const char *file_path)
+{
+    FILE *file = fopen(file_path, "rb");
+    if (file == NULL) return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = size > 0 ? malloc(size) : NULL;
+    bool ok = data != NULL && fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!ok || size < 5 || memcmp(data, REPLAY_MAGIC, 4) != 0 || data[4] != REPLAY_VERSION) {
+        free(data);
+        return false;
+    }
+
+    Reader reader = {.data = data, .size = size, .position = 5, .ok = true};
+    uint64_t seed = get_u64(&reader, 8);
+    int columns = get_u64(&reader, 2);
+    int rows = get_u64(&reader, 2);
+    uint32_t bomb_percent_bits = get_u64(&reader, 4);
+    float bomb_percent;
+    memcpy(&bomb_percent, &bomb_percent_bits, sizeof(bomb_percent));
+    recording_start(recording, seed, columns, rows, bomb_percent);
+    recording->is_no_guess = (get_u64(&reader, 1) & FLAG_NO_GUESS) != 0;
+
+    uint32_t event_count = get_varint(&reader);
+    uint32_t time = 0;
+    for (uint32_t i = 0; i < event_count && reader.ok; i++) {
+        time += get_varint(&reader);
+        replay_event_type type = get_u64(&reader, 1);
+        int x = get_varint(&reader);
+        int y = get_varint(&reader);
+        if (!reader.ok) break;
+        if (type != EVENT_REVEAL && type != EVENT_TOGGLE_FLAG && type != EVENT_CHORD) reader.ok = false;
+        else if (!recording_add_event(recording, type, time, x, y)) reader.ok = false;
+    }
+
+    recording->final_status = get_u64(&reader, 1);
+    recording->final_score = get_varint(&reader);
+    recording->final_hash = get_u64(&reader, 8);
+    free(data);
+    return reader.ok;
+}
+
+
+bool recording_replay(const Recording *recording, Board *board)
+{
+    if (!board_init(board, recording->columns, recording->rows, recording->bomb_percent, recording->seed)) {
+        return false;
+    }
+    for (int i = 0; i < recording->event_count; i++) {
+        const Replay_Event *event = &recording->events[i];
+        /* As in the game, the first reveal that opens a cell generates */
+        bool is_inside = event->x >= 0 && event->x < board->columns && event->y >= 0 && event->y < board->rows;
+        if (event->type == EVENT_REVEAL && recording->is_no_guess && !board->is_field_generated && is_inside &&
+            cell_get_state(board->cells[event->y*board->columns + event->x]) == CLOSE) {
+            no_guess_generate(board, event->x, event->y, no_guess_default_threads(), NULL);
+        }
+        switch (event->type) {
+        case EVENT_REVEAL: board_reveal(board, event->x, event->y); break;
+        case EVENT_TOGGLE_FLAG: board_toggle_flag(board, event->x, event->y); break;
+        case EVENT_CHORD: board_chord(board, event->x, event->y); break;
+        }
+    }
+    return board_get_status(board) == recording->final_status &&
+           board->score == recording->final_score &&
+           board_hash(board) == recording->final_hash;
+}
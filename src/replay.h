@@ -0,0 +1,65 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "board.h"
+
+/* A recorded game: the board settings, every reveal, chord and flag in
+ * order, and the state the board ended in. Replaying the events on a board
+ * made from the same settings must end in the same state.
+ *
+ * File layout, integers little endian, "varint" is unsigned LEB128:
+ *   "MSRP", u8 version, u64 seed, u16 columns, u16 rows, f32 bomb percent,
+ *   u8 flags (bit 0: no guess board), varint event count,
+ *   then per event:
+ *     varint milliseconds since the previous event, u8 type, varint x, varint y
+ *   u8 final status, varint final score, u64 final board_hash() */
+
+typedef enum {
+    EVENT_REVEAL = 0,
+    EVENT_TOGGLE_FLAG,
+    EVENT_CHORD,
+} replay_event_type;
+
+typedef struct {
+    /* Milliseconds since the start of the game */
+    uint32_t time_ms;
+    replay_event_type type;
+    int x;
+    int y;
+} Replay_Event;
+
+typedef struct {
+    uint64_t seed;
+    int columns;
+    int rows;
+    float bomb_percent;
+    /* Generated by no_guess_generate() on the first reveal */
+    bool is_no_guess;
+
+    Replay_Event *events;
+    int event_count;
+    int event_capacity;
+
+    board_status final_status;
+    int final_score;
+    uint64_t final_hash;
+} Recording;
+
+/* Start recording a game played on board_init(columns, rows, bomb_percent, seed) */
+void recording_start(Recording *recording, uint64_t seed, int columns, int rows, float bomb_percent);
+bool recording_add_event(Recording *recording, replay_event_type type, uint32_t time_ms, int x, int y);
+/* Remember the state the game ended in */
+void recording_finish(Recording *recording, const Board *board);
+void recording_free(Recording *recording);
+
+bool recording_save(const Recording *recording, const char *file_path);
+/* Returns false if the file can't be read or is not a recording */
+bool recording_load(Recording *recording, const char *file_path);
+
+/* Play the events on `board` as fast as possible, ignoring their times.
+ * Returns true if the board ends in the recorded state */
+bool recording_replay(const Recording *recording, Board *board);
+
+#endif // REPLAY_H_
@@ -0,0 +1,330 @@
+#include <stdlib.h>
+#include <string.h>
+#include "solver.h"
+
+/* Bit of the neighbour at (sx, sy) in Solver.unknowns */
+#define NEIGHBOUR_BIT(sx, sy) (1u << (((sx) + 1) + ((sy) + 1)*3))
+
+/* The pair rule works on the 7x7 window around the count it checks, as
+ * bit masks with bit (dx + 3) + (dy + 3)*7 for the cell at (dx, dy) */
+#define WINDOW_SIZE 7
+
+
+bool solver_reset(Solver *solver, const Board *board)
+{
+    int cells = board->columns*board->rows;
+    if (cells > solver->capacity) {
+        uint8_t *new_cells = realloc(solver->cells, cells*sizeof(*solver->cells));
+        if (new_cells == NULL) return false;
+        solver->cells = new_cells;
+        uint16_t *unknowns = realloc(solver->unknowns, cells*sizeof(*solver->unknowns));
+        if (unknowns == NULL) return false;
+        solver->unknowns = unknowns;
+        uint8_t *known_bombs = realloc(solver->known_bombs, cells*sizeof(*solver->known_bombs));
+        if (known_bombs == NULL) return false;
+        solver->known_bombs = known_bombs;
+        int *queue = realloc(solver->queue, cells*sizeof(*solver->queue));
+        if (queue == NULL) return false;
+        solver->queue = queue;
+        int *pair_queue = realloc(solver->pair_queue, cells*sizeof(*solver->pair_queue));
+        if (pair_queue == NULL) return false;
+        solver->pair_queue = pair_queue;
+        int *safe_cells = realloc(solver->safe_cells, cells*sizeof(*solver->safe_cells));
+        if (safe_cells == NULL) return false;
+        solver->safe_cells = safe_cells;
+        int *changes = realloc(solver->changes, cells*sizeof(*solver->changes));
+        if (changes == NULL) return false;
+        solver->changes = changes;
+        solver->capacity = cells;
+    }
+
+    solver->columns = board->columns;
+    solver->rows = board->rows;
+    memset(solver->cells, 0, cells*sizeof(*solver->cells));
+    memset(solver->known_bombs, 0, cells*sizeof(*solver->known_bombs));
+
+    /* Every neighbour inside the board is undecided */
+    for (int y = 0; y < board->rows; y++) {
+        uint16_t row_mask = 0x1FF & ~NEIGHBOUR_BIT(0, 0);
+        if (y == 0) row_mask &= ~(NEIGHBOUR_BIT(-1, -1) | NEIGHBOUR_BIT(0, -1) | NEIGHBOUR_BIT(1, -1));
+        if (y == board->rows - 1) row_mask &= ~(NEIGHBOUR_BIT(-1, 1) | NEIGHBOUR_BIT(0, 1) | NEIGHBOUR_BIT(1, 1));
+        for (int x = 0; x < board->columns; x++) {
+            uint16_t mask = row_mask;
+            if (x == 0) mask &= ~(NEIGHBOUR_BIT(-1, -1) | NEIGHBOUR_BIT(-1, 0) | NEIGHBOUR_BIT(-1, 1));
+            if (x == board->columns - 1) mask &= ~(NEIGHBOUR_BIT(1, -1) | NEIGHBOUR_BIT(1, 0) | NEIGHBOUR_BIT(1, 1));
+            solver->unknowns[y*board->columns + x] = mask;
+        }
+    }
+
+    solver->queue_size = 0;
+    solver->pair_queue_size = 0;
+    solver->safe_count = 0;
+    solver->change_count = 0;
+    solver->is_all_changed = true;
+    solver->deduced_safe = 0;
+    solver->deduced_bombs = 0;
+    return true;
+}
+
+
+void solver_free(Solver *solver)
+{
+    free(solver->cells);
+    free(solver->unknowns);
+    free(solver->known_bombs);
+    free(solver->queue);
+    free(solver->pair_queue);
+    free(solver->safe_cells);
+    free(solver->changes);
+    memset(solver, 0, sizeof(*solver));
+}
+
+
+/* Every cell is queued at most once at a time, so the queue can't outgrow
+ * the cell count */
+static void enqueue(Solver *solver, int cell_index)
+{
+    uint8_t *c = &solver->cells[cell_index];
+    if ((*c & SOLVER_OPEN_BIT) == 0 || (*c & SOLVER_QUEUED_BIT) != 0) return;
+    *c |= SOLVER_QUEUED_BIT;
+    solver->queue[solver->queue_size++] = cell_index;
+}
+
+
+/* Every cell is listed at most once between two solver_clear_changes() */
+static void note_change(Solver *solver, int cell_index)
+{
+    uint8_t *c = &solver->cells[cell_index];
+    if (solver->is_all_changed || (*c & SOLVER_CHANGED_BIT) != 0) return;
+    *c |= SOLVER_CHANGED_BIT;
+    solver->changes[solver->change_count++] = cell_index;
+}
+
+
+/* A cell got decided: take it out of the masks of its neighbours and
+ * queue the counts among them */
+static void decide(Solver *solver, int cell_index, bool is_bomb)
+{
+    note_change(solver, cell_index);
+    int x = cell_index % solver->columns;
+    int y = cell_index / solver->columns;
+    for (int sy = -1; sy <= 1; sy++) {
+        for (int sx = -1; sx <= 1; sx++) {
+            if (x + sx < 0 || x + sx >= solver->columns) continue;
+            if (y + sy < 0 || y + sy >= solver->rows) continue;
+            int neighbour_index = (y + sy)*solver->columns + (x + sx);
+            /* The decided cell is at (-sx, -sy) from the neighbour */
+            solver->unknowns[neighbour_index] &= ~NEIGHBOUR_BIT(-sx, -sy);
+            solver->known_bombs[neighbour_index] += is_bomb;
+            enqueue(solver, neighbour_index);
+        }
+    }
+}
+
+
+static void mark_safe(Solver *solver, int cell_index)
+{
+    uint8_t *c = &solver->cells[cell_index];
+    if ((*c & (SOLVER_SAFE_BIT | SOLVER_BOMB_BIT)) != 0) return;
+    *c |= SOLVER_SAFE_BIT;
+    solver->deduced_safe++;
+    solver->safe_cells[solver->safe_count++] = cell_index;
+    decide(solver, cell_index, false);
+}
+
+static void mark_bomb(Solver *solver, int cell_index)
+{
+    uint8_t *c = &solver->cells[cell_index];
+    if ((*c & (SOLVER_SAFE_BIT | SOLVER_BOMB_BIT)) != 0) return;
+    *c |= SOLVER_BOMB_BIT;
+    solver->deduced_bombs++;
+    decide(solver, cell_index, true);
+}
+
+
+static void observe_open(Solver *solver, int cell_index)
+{
+    uint8_t *c = &solver->cells[cell_index];
+    if ((*c & SOLVER_OPEN_BIT) != 0) return;
+    bool was_safe = (*c & SOLVER_SAFE_BIT) != 0;
+    *c |= SOLVER_OPEN_BIT | SOLVER_SAFE_BIT;
+    /* A cell deduced safe is already out of its neighbours' masks */
+    if (was_safe) {
+        note_change(solver, cell_index);
+        enqueue(solver, cell_index);
+    } else {
+        decide(solver, cell_index, false);
+    }
+}
+
+
+/* Bombs among the undecided neighbours of an open count */
+static inline int bombs_needed(const Solver *solver, const Board *board, int cell_index)
+{
+    return cell_bombs_around(board->cells[cell_index]) - solver->known_bombs[cell_index];
+}
+
+
+/* Spread a neighbour mask over the window around its cell */
+static inline uint64_t neighbours_window(uint16_t unknowns)
+{
+    return (uint64_t)(unknowns & 0x7) << (2 + 2*WINDOW_SIZE) |
+           (uint64_t)((unknowns >> 3) & 0x7) << (2 + 3*WINDOW_SIZE) |
+           (uint64_t)((unknowns >> 6) & 0x7) << (2 + 4*WINDOW_SIZE);
+}
+
+
+static int count_bits(uint64_t mask)
+{
+    int count = 0;
+    for (; mask != 0; mask &= mask - 1) count++;
+    return count;
+}
+
+
+/* Mark the cells of a window mask around (x, y) */
+static void mark_window(Solver *solver, int x, int y, uint64_t mask, bool is_bomb)
+{
+    for (; mask != 0; mask &= mask - 1) {
+        int bit = 0;
+        while ((mask & (1ull << bit)) == 0) bit++;
+        int cell_index = (y + bit/WINDOW_SIZE - 3)*solver->columns + (x + bit%WINDOW_SIZE - 3);
+        if (is_bomb) mark_bomb(solver, cell_index);
+        else mark_safe(solver, cell_index);
+    }
+}
+
+
+/* If `a` needs exactly as many bombs beyond `b` as it has cells outside
+ * of `b`, those cells are bombs and the cells of `b` outside of `a` are
+ * safe. Returns true if anything was deduced */
+static bool apply_pair_rule(Solver *solver, int x, int y, uint64_t a, int a_bombs, uint64_t b, int b_bombs)
+{
+    uint64_t only_a = a & ~b;
+    uint64_t only_b = b & ~a;
+    if (a_bombs - b_bombs != count_bits(only_a)) return false;
+    if ((only_a | only_b) == 0) return false;
+    mark_window(solver, x, y, only_a, true);
+    mark_window(solver, x, y, only_b, false);
+    return true;
+}
+
+
+/* Returns false if the count still has undecided neighbours */
+static bool check_count(Solver *solver, const Board *board, int cell_index)
+{
+    uint16_t unknowns = solver->unknowns[cell_index];
+    if (unknowns == 0) return true;
+    int bombs = bombs_needed(solver, board, cell_index);
+    if (bombs != 0 && bombs != count_bits(unknowns)) return false;
+
+    int x = cell_index % solver->columns;
+    int y = cell_index / solver->columns;
+    mark_window(solver, x, y, neighbours_window(unknowns), bombs > 0);
+    return true;
+}
+
+
+static void check_pairs(Solver *solver, const Board *board, int cell_index)
+{
+    uint64_t a = neighbours_window(solver->unknowns[cell_index]);
+    if (a == 0) return;
+    int a_bombs = bombs_needed(solver, board, cell_index);
+
+    /* Counts that share a neighbour with this one are at most two cells
+     * away */
+    int x = cell_index % solver->columns;
+    int y = cell_index / solver->columns;
+    for (int oy = -2; oy <= 2; oy++) {
+        for (int ox = -2; ox <= 2; ox++) {
+            if (ox == 0 && oy == 0) continue;
+            if (x + ox < 0 || x + ox >= solver->columns) continue;
+            if (y + oy < 0 || y + oy >= solver->rows) continue;
+            /* A count still waiting in a queue checks this pair itself */
+            int other_index = (y + oy)*solver->columns + (x + ox);
+            uint8_t other = solver->cells[other_index];
+            if ((other & SOLVER_OPEN_BIT) == 0) continue;
+            if ((other & (SOLVER_QUEUED_BIT | SOLVER_PAIR_QUEUED_BIT)) != 0) continue;
+
+            int shift = ox + oy*WINDOW_SIZE;
+            uint64_t b = neighbours_window(solver->unknowns[other_index]);
+            b = shift >= 0 ? b << shift : b >> -shift;
+            if ((a & b) == 0) continue;
+            int b_bombs = bombs_needed(solver, board, other_index);
+            if (apply_pair_rule(solver, x, y, a, a_bombs, b, b_bombs) ||
+                apply_pair_rule(solver, x, y, b, b_bombs, a, a_bombs)) {
+                /* The pairs left unchecked are checked on the next visit */
+                enqueue(solver, cell_index);
+                return;
+            }
+        }
+    }
+}
+
+
+void solver_update(Solver *solver, const Board *board)
+{
+    /* A lost board shows its bombs as open cells */
+    if (board->status == BOARD_LOST) return;
+
+    if (board->is_all_changed) {
+        for (int i = 0; i < solver->columns*solver->rows; i++) {
+            if (cell_get_state(board->cells[i]) == OPEN) observe_open(solver, i);
+        }
+    } else {
+        for (int i = 0; i < board->change_count; i++) {
+            int cell_index = board->changes[i];
+            if (cell_get_state(board->cells[cell_index]) == OPEN) observe_open(solver, cell_index);
+        }
+    }
+
+    for (;;) {
+        if (solver->queue_size > 0) {
+            int cell_index = solver->queue[--solver->queue_size];
+            solver->cells[cell_index] &= ~SOLVER_QUEUED_BIT;
+            if (check_count(solver, board, cell_index)) continue;
+            if ((solver->cells[cell_index] & SOLVER_PAIR_QUEUED_BIT) != 0) continue;
+            solver->cells[cell_index] |= SOLVER_PAIR_QUEUED_BIT;
+            solver->pair_queue[solver->pair_queue_size++] = cell_index;
+        } else if (solver->pair_queue_size > 0) {
+            int cell_index = solver->pair_queue[--solver->pair_queue_size];
+            solver->cells[cell_index] &= ~SOLVER_PAIR_QUEUED_BIT;
+            check_pairs(solver, board, cell_index);
+        } else {
+            break;
+        }
+    }
+}
+
+
+void solver_clear_changes(Solver *solver)
+{
+    for (int i = 0; i < solver->change_count; i++) solver->cells[solver->changes[i]] &= ~SOLVER_CHANGED_BIT;
+    solver->change_count = 0;
+    solver->is_all_changed = false;
+}
+
+
+bool solver_next_safe(Solver *solver, const Board *board, int *x, int *y)
+{
+    while (solver->safe_count > 0) {
+        int cell_index = solver->safe_cells[--solver->safe_count];
+        if (cell_get_state(board->cells[cell_index]) == OPEN) continue;
+        *x = cell_index % solver->columns;
+        *y = cell_index / solver->columns;
+        return true;
+    }
+    return false;
+}
+
+
+bool solver_is_safe(const Solver *solver, int x, int y)
+{
+    return (solver->cells[y*solver->columns + x] & SOLVER_SAFE_BIT) != 0;
+}
+
+
+bool solver_is_bomb(const Solver *solver, int x, int y)
+{
+    return (solver->cells[y*solver->columns + x] & SOLVER_BOMB_BIT) != 0;
+}
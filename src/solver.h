@@ -0,0 +1,83 @@
+#ifndef SOLVER_H_
+#define SOLVER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "board.h"
+
+/* Rule-based solver over what the player can see of a Board: the open
+ * cells and their counts, never the bomb bits. It finds the closed cells
+ * that are provably safe or provably bombs with two rules:
+ *   - single cell: a count whose bombs are all known, or whose unknown
+ *     neighbours must all be bombs;
+ *   - pair: for two counts A and B, if the bombs A needs beyond B equal
+ *     the cells only A sees, those are bombs and the cells only B sees
+ *     are safe. This covers the subset rule and patterns like 1-2-1.
+ * Deductions feed each other until nothing more follows. Player flags
+ * are not trusted, the solver keeps its own marks.
+ *
+ * The solver is incremental: solver_update() only looks at the cells the
+ * board changed, and rechecks the counts around them. The pair rule costs
+ * far more than the single cell rules, so it only runs once those are
+ * stuck. */
+
+/* Per cell solver state */
+#define SOLVER_SAFE_BIT        0x01
+#define SOLVER_BOMB_BIT        0x02
+#define SOLVER_OPEN_BIT        0x04
+#define SOLVER_QUEUED_BIT      0x08
+#define SOLVER_PAIR_QUEUED_BIT 0x10
+#define SOLVER_CHANGED_BIT     0x20
+
+typedef struct {
+    int columns;
+    int rows;
+    int capacity;
+    uint8_t *cells;
+    /* Undecided neighbours of every cell, bit (sx + 1) + (sy + 1)*3 for
+     * the one at (x + sx, y + sy), and count of those known to be bombs */
+    uint16_t *unknowns;
+    uint8_t *known_bombs;
+
+    /* Open counts that have to be checked again, and those the single
+     * cell rules could not finish */
+    int *queue;
+    int queue_size;
+    int *pair_queue;
+    int pair_queue_size;
+
+    /* Deduced safe cells the board may not have opened yet */
+    int *safe_cells;
+    int safe_count;
+
+    /* Cells opened or decided since the last solver_clear_changes(), each
+     * listed once. After solver_reset() every cell counts as changed */
+    int *changes;
+    int change_count;
+    bool is_all_changed;
+
+    /* Totals since solver_reset() */
+    int deduced_safe;
+    int deduced_bombs;
+} Solver;
+
+/* Forget everything and size the solver for `board`. Zero-initialized
+ * Solver is valid input. Returns false if it could not allocate */
+bool solver_reset(Solver *solver, const Board *board);
+void solver_free(Solver *solver);
+
+/* Take in the cells changed since the last board_clear_changes() and
+ * deduce everything that follows. The caller clears the changes */
+void solver_update(Solver *solver, const Board *board);
+
+/* Forget the changed cells once they are taken in */
+void solver_clear_changes(Solver *solver);
+
+/* Pop a deduced safe cell that is still closed on the board. Returns false
+ * when there is none left */
+bool solver_next_safe(Solver *solver, const Board *board, int *x, int *y);
+
+bool solver_is_safe(const Solver *solver, int x, int y);
+bool solver_is_bomb(const Solver *solver, int x, int y);
+
+#endif // SOLVER_H_
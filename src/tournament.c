@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "board.h"
+#include "solver.h"
+#include "probability.h"
+
+/* Headless bot tournament: plays many games of every difficulty preset
+ * with a strategy, spread over a pool of threads. Build with ./build.sh
+ * and run ./build/tournament [--games <n>] [--threads <n>]
+ * [--strategy random|solver|probability|all] [--seed <n>]. The default
+ * count of games finishes in seconds; runs of millions of games per
+ * preset need an explicit --games.
+ *
+ * "3BV/s (bot CPU)" is the 3BV of a won game over the CPU time its thread
+ * spent playing it, choosing and making the moves, averaged over the won
+ * games. It is not comparable to the 3BV/s of a human player, which
+ * counts wall time.
+ *
+ * Game i of a preset is made from a seed that depends only on i, and the
+ * random choices of a game come from a stream seeded by that same seed,
+ * so the counts merge to the same totals whatever the thread count. Only
+ * the timings vary between runs. */
+
+/* Games per preset, a quick run */
+#define DEFAULT_GAMES    10000
+#define DEFAULT_SEED     1
+#define MAX_THREADS      256
+/* Games a worker takes at once */
+#define GAMES_PER_CHUNK  256
+/* Same as the presets of the difficulty menu */
+#define PRESET_BOMB_PERCENT 15.625
+
+typedef enum {
+    STRATEGY_RANDOM = 0,
+    STRATEGY_SOLVER,
+    STRATEGY_PROBABILITY,
+    STRATEGY_COUNT,
+} strategy;
+
+static const char *strategy_names[] = {
+    [STRATEGY_RANDOM]      = "random",
+    [STRATEGY_SOLVER]      = "solver",
+    [STRATEGY_PROBABILITY] = "probability",
+};
+
+static const struct {
+    int columns;
+    int rows;
+} presets[] = {
+    {8, 8},
+    {16, 16},
+    {25, 16},
+};
+
+typedef struct {
+    long games;
+    long won;
+    /* 3BV of the won games */
+    long won_3bv;
+    /* Sum of 3BV per second of thinking over the won games */
+    double won_3bv_per_second;
+} Totals;
+
+typedef struct {
+    strategy strategy;
+    int columns;
+    int rows;
+    uint64_t seed;
+    long games;
+
+    pthread_mutex_t mutex;
+    long next_game;
+    Totals totals;
+} Tournament;
+
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+
+/* CPU time of the calling thread, so that games are not charged for the
+ * time their thread waited on a busy CPU */
+static double thread_cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+
+static uint64_t next_random(uint64_t *state)
+{
+    /* splitmix64 */
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+
+/* A uniformly chosen closed cell that the solver does not know to be a
+ * bomb. `solver` is NULL for the random strategy */
+static int random_closed_cell(const Board *board, const Solver *solver, uint64_t *rng)
+{
+    int cells = board->columns*board->rows;
+    int candidates = 0;
+    for (int i = 0; i < cells; i++) {
+        if (cell_get_state(board->cells[i]) == OPEN) continue;
+        if (solver != NULL && (solver->cells[i] & SOLVER_BOMB_BIT) != 0) continue;
+        candidates++;
+    }
+    /* The multiply-shift bias is far below what a tournament can show */
+    int chosen = (int)(((next_random(rng) >> 32)*(uint64_t)candidates) >> 32);
+    for (int i = 0; i < cells; i++) {
+        if (cell_get_state(board->cells[i]) == OPEN) continue;
+        if (solver != NULL && (solver->cells[i] & SOLVER_BOMB_BIT) != 0) continue;
+        if (chosen-- == 0) return i;
+    }
+    return -1;
+}
+
+
+/* Play one game to its end. Every strategy opens the middle first */
+static void play_game(strategy strategy, Board *board, Solver *solver, Probability *engine, uint64_t *rng)
+{
+    board_reveal(board, board->columns/2, board->rows/2);
+    if (strategy != STRATEGY_RANDOM) solver_reset(solver, board);
+
+    while (board_get_status(board) == BOARD_PLAYING) {
+        int x, y;
+        if (strategy == STRATEGY_RANDOM) {
+            int cell_index = random_closed_cell(board, NULL, rng);
+            board_reveal(board, cell_index % board->columns, cell_index / board->columns);
+            continue;
+        }
+
+        solver_update(solver, board);
+        board_clear_changes(board);
+        if (solver_next_safe(solver, board, &x, &y)) {
+            board_reveal(board, x, y);
+        } else if (strategy == STRATEGY_PROBABILITY && probability_compute(engine, board, solver) &&
+                   probability_safest_cell(engine, board, solver, &x, &y)) {
+            solver_clear_changes(solver);
+            board_reveal(board, x, y);
+        } else {
+            int cell_index = random_closed_cell(board, solver, rng);
+            board_reveal(board, cell_index % board->columns, cell_index / board->columns);
+        }
+    }
+}
+
+
+static void *run_worker(void *arg)
+{
+    Tournament *tournament = arg;
+    Board board = {0};
+    Solver solver = {0};
+    Probability engine;
+    probability_init(&engine, 0);
+    Totals totals = {0};
+
+    for (;;) {
+        pthread_mutex_lock(&tournament->mutex);
+        long first = tournament->next_game;
+        tournament->next_game += GAMES_PER_CHUNK;
+        pthread_mutex_unlock(&tournament->mutex);
+        if (first >= tournament->games) break;
+        long last = first + GAMES_PER_CHUNK < tournament->games ? first + GAMES_PER_CHUNK : tournament->games;
+
+        for (long game = first; game < last; game++) {
+            /* The board and the choices of the bot get separate streams */
+            uint64_t game_seed = tournament->seed + (uint64_t)game*0x9E3779B97F4A7C15ull;
+            uint64_t board_seed = next_random(&game_seed);
+            uint64_t rng = next_random(&game_seed);
+            board_init(&board, tournament->columns, tournament->rows, PRESET_BOMB_PERCENT, board_seed);
+
+            double start = thread_cpu_seconds();
+            play_game(tournament->strategy, &board, &solver, &engine, &rng);
+            double seconds = thread_cpu_seconds() - start;
+
+            totals.games++;
+            if (board_get_status(&board) != BOARD_WON) continue;
+            int bbbv = board_3bv(&board);
+            totals.won++;
+            totals.won_3bv += bbbv;
+            if (seconds > 0) totals.won_3bv_per_second += bbbv/seconds;
+        }
+    }
+
+    pthread_mutex_lock(&tournament->mutex);
+    tournament->totals.games += totals.games;
+    tournament->totals.won += totals.won;
+    tournament->totals.won_3bv += totals.won_3bv;
+    tournament->totals.won_3bv_per_second += totals.won_3bv_per_second;
+    pthread_mutex_unlock(&tournament->mutex);
+
+    probability_free(&engine);
+    solver_free(&solver);
+    board_free(&board);
+    return NULL;
+}
+
+
+static void run_tournament(strategy strategy, int preset, long games, int threads, uint64_t seed)
+{
+    Tournament tournament = {
+        .strategy = strategy,
+        .columns = presets[preset].columns,
+        .rows = presets[preset].rows,
+        /* Every preset gets its own games */
+        .seed = seed*0xBF58476D1CE4E5B9ull + preset,
+        .games = games,
+    };
+    pthread_mutex_init(&tournament.mutex, NULL);
+
+    double start = now_seconds();
+    pthread_t workers[MAX_THREADS];
+    int worker_count = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[worker_count], NULL, run_worker, &tournament) != 0) break;
+        worker_count++;
+    }
+    run_worker(&tournament);
+    for (int i = 0; i < worker_count; i++) pthread_join(workers[i], NULL);
+    double seconds = now_seconds() - start;
+    pthread_mutex_destroy(&tournament.mutex);
+
+    Totals *totals = &tournament.totals;
+    printf("%-12s %5dx%-5d %10ld %10ld %8.3f%% %10.1f %15.0f %12.0f\n",
+           strategy_names[strategy], tournament.columns, tournament.rows,
+           totals->games, totals->won, 100.0*totals->won/totals->games,
+           totals->won > 0 ? (double)totals->won_3bv/totals->won : 0,
+           totals->won > 0 ? totals->won_3bv_per_second/totals->won : 0,
+           totals->games/seconds);
+}
+
+
+int main(int argc, char **argv)
+{
+    long games = DEFAULT_GAMES;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus < 1 ? 1 : cpus > MAX_THREADS ? MAX_THREADS : cpus;
+    uint64_t seed = DEFAULT_SEED;
+    int first_strategy = 0;
+    int last_strategy = STRATEGY_COUNT - 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc && atol(argv[i + 1]) > 0) {
+            games = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            threads = atoi(argv[++i]);
+            if (threads > MAX_THREADS) threads = MAX_THREADS;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "all") == 0) continue;
+            first_strategy = -1;
+            for (int s = 0; s < STRATEGY_COUNT; s++) {
+                if (strcmp(name, strategy_names[s]) == 0) first_strategy = last_strategy = s;
+            }
+            if (first_strategy < 0) {
+                fprintf(stderr, "ERROR: unknown strategy %s\n", name);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--games <n>] [--threads <n>] "
+                            "[--strategy random|solver|probability|all] [--seed <n>]\n"
+                            "  --games defaults to %d per preset\n", argv[0], DEFAULT_GAMES);
+            return 1;
+        }
+    }
+
+    printf("%d threads, %ld games per preset, seed %llu\n", threads, games, (unsigned long long)seed);
+    printf("%-12s %11s %10s %10s %9s %10s %15s %12s\n",
+           "strategy", "size", "games", "won", "win rate", "mean 3BV", "3BV/s (bot CPU)", "games/s");
+    for (int s = first_strategy; s <= last_strategy; s++) {
+        for (size_t p = 0; p < sizeof(presets)/sizeof(presets[0]); p++) {
+            run_tournament(s, p, games, threads, seed);
+        }
+    }
+    return 0;
+}